@@ -3,18 +3,45 @@
 #include "console.h"
 #include "logger.h"
 #include "io_interface.h"
+#include "profiler.h"
 
 
 int main(int argc, char* argv[]) {
   Logger log = Logger::getLogger("main");
-  if (argc != 2) {
+  std::string path;
+  std::string replay;
+  int runAhead = 0;
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--run-ahead" && i + 1 < argc)
+      runAhead = std::stoi(argv[++i]);
+    else if (arg == "--replay" && i + 1 < argc)
+      replay = argv[++i];
+    else
+      path = arg;
+  }
+  if (path == "") {
     log.error() << "Oops, path to a .nes file was not provided\n";
+    log.error() << "usage: asten [--run-ahead FRAMES] [--replay SCREEN_LOG] <ROM_FILE>\n";
     return -1;
   } 
-  std::string path(argv[1]);
+  if (replay != "") {
+    // the emulation only sets the pace of the replay
+    Console console(path, InterfaceType::REPLAY, "", replay);
+    while (console.isRunning()) {
+      console.step();
+    }
+    return 0;
+  }
   Console console(path, InterfaceType::MONITOR, "",  "");
+  console.enableRewind();
+  console.setRunAhead(runAhead);
   while (console.isRunning()) {
     console.step();
   }
+#ifdef ASTEN_PROFILER
+  utils::Profiler::get().printTable(std::cout);
+  utils::Profiler::get().writeTrace(utils::PROFILE_TRACE_FILE);
+#endif
   return 0;
 }
@@ -0,0 +1,120 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+#include "logger.h"
+
+namespace bench {
+
+volatile uint32_t sink = 0;
+
+State::State(long n): iterations(n), elapsed(0) {}
+
+void State::start() {
+  begin = std::chrono::steady_clock::now();
+}
+
+void State::stop() {
+  std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+  elapsed += d.count();
+}
+
+double State::seconds() const { return elapsed; }
+
+std::vector<Benchmark>& registry() {
+  // built on first use, as registrars run during static initialization
+  static std::vector<Benchmark> benchmarks;
+  return benchmarks;
+}
+
+Registrar::Registrar(std::string name, Function run) {
+  registry().push_back(Benchmark{name, run});
+}
+
+} // namespace bench
+
+namespace {
+
+double runOnce(bench::Function f, long iterations) {
+  bench::State state(iterations);
+  f(state);
+  return state.seconds();
+}
+
+// calibrate returns a number of iterations that takes about minTime seconds
+long calibrate(bench::Function f, double minTime) {
+  long iterations = 1;
+  while (true) {
+    double seconds = runOnce(f, iterations);
+    if (seconds >= minTime / 10 || iterations >= 1L << 40) {
+      double perIteration = seconds / iterations;
+      long wanted = perIteration > 0 ? (long)(minTime / perIteration) : iterations;
+      return std::max(wanted, 1L);
+    }
+    iterations *= 10;
+  }
+}
+
+void printUsage(Logger& log) {
+  log.error() << "usage: asten-benchmarks [--filter SUBSTRING] [--repeat RUNS] [--min-time SECONDS] [--list]\n";
+}
+
+} // namespace
+
+// Each benchmark is first calibrated to run for about --min-time seconds, then
+// run --repeat times. The median time per iteration is reported, along with
+// the fastest one, as it is the least disturbed by the rest of the system.
+int main(int argc, char* argv[]) {
+  Logger log = Logger::getLogger("benchmarks");
+  std::string filter;
+  int repeat = 5;
+  double minTime = 0.2;
+  bool list = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--filter" && i + 1 < argc)
+      filter = argv[++i];
+    else if (arg == "--repeat" && i + 1 < argc)
+      repeat = std::stoi(argv[++i]);
+    else if (arg == "--min-time" && i + 1 < argc)
+      minTime = std::stod(argv[++i]);
+    else if (arg == "--list")
+      list = true;
+    else {
+      printUsage(log);
+      return -1;
+    }
+  }
+  if (repeat <= 0 || minTime <= 0) {
+    printUsage(log);
+    return -1;
+  }
+
+  if (!list) {
+    std::cout << std::left << std::setw(36) << "benchmark"
+      << std::right << std::setw(14) << "ns/op" << std::setw(14) << "min ns/op"
+      << std::setw(16) << "ops/s" << "\n";
+  }
+  for (auto& b: bench::registry()) {
+    if (b.name.find(filter) == std::string::npos)
+      continue;
+    if (list) {
+      std::cout << b.name << "\n";
+      continue;
+    }
+
+    long iterations = calibrate(b.run, minTime);
+    std::vector<double> samples;
+    for (int i = 0; i < repeat; i++)
+      samples.push_back(runOnce(b.run, iterations) * 1e9 / iterations);
+    std::sort(samples.begin(), samples.end());
+    double median = samples[samples.size() / 2];
+
+    std::cout << std::left << std::setw(36) << b.name << std::right << std::fixed
+      << std::setprecision(2) << std::setw(14) << median << std::setw(14) << samples[0]
+      << std::setprecision(0) << std::setw(16) << 1e9 / median << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,62 @@
+#ifndef GUARD_BENCHMARK_H
+#define GUARD_BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// State is handed to a benchmark, that must run the measured operation
+// iterations times between start() and stop(). Anything done outside (building
+// fixtures...) is not measured.
+class State {
+  public:
+    explicit State(long iterations);
+    const long iterations;
+    void start();
+    void stop();
+    // seconds returns the time measured between start() and stop()
+    double seconds() const;
+  private:
+    std::chrono::steady_clock::time_point begin;
+    double elapsed;
+};
+
+typedef void (*Function)(State&);
+
+struct Benchmark {
+  std::string name;
+  Function run;
+};
+
+// registry returns all the benchmarks declared with BENCHMARK, in the order
+// they were declared in
+std::vector<Benchmark>& registry();
+
+struct Registrar {
+  Registrar(std::string name, Function run);
+};
+
+// keep stores value where the compiler cannot see it, so that computing it is
+// not optimized away
+extern volatile uint32_t sink;
+inline void keep(uint32_t value) { sink = sink + value; }
+
+} // namespace bench
+
+#define BENCHMARK_CAT_(a, b) a##b
+#define BENCHMARK_CAT(a, b) BENCHMARK_CAT_(a, b)
+
+// BENCHMARK declares a benchmark named name, and opens its body, in which
+// state is a bench::State&:
+//   BENCHMARK("ppu/step", state) {
+//     ...
+//   }
+#define BENCHMARK(name, state) \
+  static void BENCHMARK_CAT(benchmark_, __LINE__)(bench::State&); \
+  static bench::Registrar BENCHMARK_CAT(registrar_, __LINE__)(name, BENCHMARK_CAT(benchmark_, __LINE__)); \
+  static void BENCHMARK_CAT(benchmark_, __LINE__)(bench::State& state)
+
+#endif
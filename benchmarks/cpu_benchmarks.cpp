@@ -0,0 +1,139 @@
+#include "benchmark.h"
+#include "fixtures.h"
+
+// Synthetic programs, each looping forever over one kind of instructions
+namespace {
+
+// arithmetic and logic on registers only
+const std::vector<uint8_t> ALU_PROGRAM = {
+  0xa9, 0x12,       // LDA #$12
+  0x69, 0x34,       // ADC #$34
+  0x29, 0xf0,       // AND #$F0
+  0x09, 0x0f,       // ORA #$0F
+  0x49, 0x55,       // EOR #$55
+  0x0a,             // ASL A
+  0xaa,             // TAX
+  0xe8,             // INX
+  0x88,             // DEY
+  0x18,             // CLC
+  0xc9, 0x10,       // CMP #$10
+  0xe9, 0x01,       // SBC #$01
+  0x4c, 0x00, 0x80, // JMP $8000
+};
+
+// loads and stores to RAM, with most addressing modes
+const std::vector<uint8_t> MEMORY_PROGRAM = {
+  0xa2, 0x03,       // LDX #$03
+  0xa0, 0x05,       // LDY #$05
+  0xa5, 0x10,       // LDA $10
+  0x85, 0x11,       // STA $11
+  0x8d, 0x00, 0x02, // STA $0200
+  0xbd, 0x00, 0x03, // LDA $0300,X
+  0x99, 0x00, 0x04, // STA $0400,Y
+  0xe6, 0x30,       // INC $30
+  0xa1, 0x40,       // LDA ($40,X)
+  0x91, 0x20,       // STA ($20),Y
+  0xac, 0x00, 0x05, // LDY $0500
+  0x4c, 0x00, 0x80, // JMP $8000
+};
+
+// a counted loop calling a subroutine
+std::vector<uint8_t> branchProgram() {
+  std::vector<uint8_t> code = {
+    0xa2, 0x10,       // LDX #$10
+    0xca,             // DEX
+    0xd0, 0xfd,       // BNE -3
+    0x20, 0x00, 0x81, // JSR $8100
+    0x4c, 0x00, 0x80, // JMP $8000
+  };
+  code.resize(0x100, 0xea);
+  code.push_back(0x60); // RTS
+  return code;
+}
+
+void runProgram(bench::State& state, const std::vector<uint8_t>& code) {
+  bench::FakeConsole console(0, bench::makePrg(2, code), bench::makeChr(1));
+  CPU& cpu = console.get().getCpu();
+  state.start();
+  for (long i = 0; i < state.iterations; i++)
+    bench::keep(cpu.step());
+  state.stop();
+}
+
+} // namespace
+
+BENCHMARK("cpu/step/alu", state) {
+  runProgram(state, ALU_PROGRAM);
+}
+
+BENCHMARK("cpu/step/memory", state) {
+  runProgram(state, MEMORY_PROGRAM);
+}
+
+BENCHMARK("cpu/step/branches", state) {
+  runProgram(state, branchProgram());
+}
+
+// Bus accesses, for each region of the CPU address space
+namespace {
+
+typedef uint8_t (*Read)(CPUMemory&, long);
+typedef void (*Write)(CPUMemory&, long);
+
+void runReads(bench::State& state, Read read) {
+  bench::FakeConsole console(0, bench::makePrg(2, ALU_PROGRAM), bench::makeChr(1));
+  CPUMemory& mem = console.get().getCpu().getMemory();
+  state.start();
+  for (long i = 0; i < state.iterations; i++)
+    bench::keep(read(mem, i));
+  state.stop();
+}
+
+void runWrites(bench::State& state, Write write) {
+  bench::FakeConsole console(0, bench::makePrg(2, ALU_PROGRAM), bench::makeChr(1));
+  CPUMemory& mem = console.get().getCpu().getMemory();
+  state.start();
+  for (long i = 0; i < state.iterations; i++)
+    write(mem, i);
+  state.stop();
+}
+
+} // namespace
+
+BENCHMARK("bus/read/ram", state) {
+  runReads(state, [](CPUMemory& m, long i) { return m.read(i & 0x1fff); });
+}
+
+BENCHMARK("bus/read/ppu-registers", state) {
+  // PPUSTATUS, through all its mirrors (other registers are mostly write only)
+  runReads(state, [](CPUMemory& m, long i) { return m.read(0x2002 + 8 * (i & 0x3ff)); });
+}
+
+BENCHMARK("bus/read/controllers", state) {
+  runReads(state, [](CPUMemory& m, long i) { return m.read(0x4016 + (i & 1)); });
+}
+
+BENCHMARK("bus/read/prg-ram", state) {
+  runReads(state, [](CPUMemory& m, long i) { return m.read(0x6000 + (i & 0x1fff)); });
+}
+
+BENCHMARK("bus/read/prg-rom", state) {
+  runReads(state, [](CPUMemory& m, long i) { return m.read(0x8000 + (i & 0x7fff)); });
+}
+
+BENCHMARK("bus/write/ram", state) {
+  runWrites(state, [](CPUMemory& m, long i) { m.write(i & 0x1fff, i); });
+}
+
+BENCHMARK("bus/write/ppu-registers", state) {
+  // alternates PPUADDR and PPUDATA, so that writes land all over VRAM
+  runWrites(state, [](CPUMemory& m, long i) { m.write(0x2006 + (i & 1), i); });
+}
+
+BENCHMARK("bus/write/controllers", state) {
+  runWrites(state, [](CPUMemory& m, long i) { m.write(0x4016, i & 1); });
+}
+
+BENCHMARK("bus/write/prg-ram", state) {
+  runWrites(state, [](CPUMemory& m, long i) { m.write(0x6000 + (i & 0x1fff), i); });
+}
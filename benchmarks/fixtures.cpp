@@ -0,0 +1,82 @@
+#include "fixtures.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include "io_interface.h"
+
+namespace bench {
+
+namespace {
+const int PRG_UNIT = 0x4000;
+const int CHR_UNIT = 0x2000;
+// address of the RTI all interrupts jump to
+const uint16_t INTERRUPT_HANDLER = 0xfff0;
+} // namespace
+
+FakeConsole::FakeConsole(int mapperId, const std::vector<uint8_t>& prg, const std::vector<uint8_t>& chr) {
+  // consoles only load cartridges from files, so write one (the whole file is
+  // read by the constructor, and can be removed right after)
+  std::string path = "benchmark_fixture.nes";
+  uint8_t header[16] = {
+    'N', 'E', 'S', 0x1a,
+    (uint8_t)(prg.size() / PRG_UNIT), (uint8_t)(chr.size() / CHR_UNIT),
+    (uint8_t)((mapperId & 0xf) << 4), (uint8_t)(mapperId & 0xf0),
+  };
+  std::ofstream out(path, std::ios::binary);
+  out.write((char*)header, sizeof(header));
+  out.write((char*)prg.data(), prg.size());
+  out.write((char*)chr.data(), chr.size());
+  out.close();
+  console = new Console(path, InterfaceType::SINK, "", "");
+  std::remove(path.c_str());
+}
+
+FakeConsole::~FakeConsole() { delete console; }
+
+Console& FakeConsole::get() { return *console; }
+
+std::vector<uint8_t> makePrg(int units, const std::vector<uint8_t>& code) {
+  std::vector<uint8_t> prg(units * PRG_UNIT, 0xea); // NOP
+  std::copy(code.begin(), code.end(), prg.begin());
+  // the last 16kB are mapped at $c000
+  size_t last = prg.size() - 0x4000;
+  prg[last + INTERRUPT_HANDLER - 0xc000] = 0x40; // RTI
+  uint16_t vectors[3] = {INTERRUPT_HANDLER, 0x8000, INTERRUPT_HANDLER};
+  for (int i = 0; i < 3; i++) {
+    prg[last + 0x3ffa + 2 * i] = vectors[i] & 0xff;
+    prg[last + 0x3ffa + 2 * i + 1] = vectors[i] >> 8;
+  }
+  return prg;
+}
+
+std::vector<uint8_t> makeChr(int units) {
+  std::vector<uint8_t> chr(units * CHR_UNIT);
+  uint32_t seed = 0x1234567;
+  for (auto& b: chr) {
+    seed = seed * 1103515245 + 12345;
+    b = seed >> 16;
+  }
+  return chr;
+}
+
+std::vector<uint8_t> makeScreen() {
+  std::vector<uint8_t> screen(IOInterface::WIDTH * IOInterface::HEIGHT);
+  for (int y = 0; y < IOInterface::HEIGHT; y++) {
+    for (int x = 0; x < IOInterface::WIDTH; x++) {
+      uint8_t color;
+      if (y < 120)
+        color = 0x21; // sky
+      else if ((x / 8 + y / 8) % 4 == 0)
+        color = 0x0f;
+      else
+        color = 0x1a + (x / 16) % 3;
+      if ((x * y) % 37 == 1)
+        color = 0x30;
+      screen[y * IOInterface::WIDTH + x] = color;
+    }
+  }
+  return screen;
+}
+
+} // namespace bench
@@ -0,0 +1,42 @@
+#ifndef GUARD_FIXTURES_H
+#define GUARD_FIXTURES_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "console.h"
+
+namespace bench {
+
+// FakeConsole is a headless console running a cartridge built in memory, so
+// that benchmarks do not depend on ROM files and always run the same code.
+class FakeConsole {
+  public:
+    // prg and chr are the content of the PRG and CHR ROMs, in units of 16kB
+    // and 8kB respectively
+    FakeConsole(int mapperId, const std::vector<uint8_t>& prg, const std::vector<uint8_t>& chr);
+    ~FakeConsole();
+    FakeConsole(const FakeConsole&) = delete;
+    FakeConsole& operator=(const FakeConsole&) = delete;
+    Console& get();
+  private:
+    Console *console;
+};
+
+// makePrg returns units * 16kB of PRG ROM with code at $8000, where the CPU
+// starts. Interrupts return immediately.
+std::vector<uint8_t> makePrg(int units, const std::vector<uint8_t>& code);
+
+// makeChr returns units * 8kB of CHR ROM filled with (deterministic) noise,
+// so that all tiles have some visible pixels
+std::vector<uint8_t> makeChr(int units);
+
+// makeScreen returns the palette indexes of a frame that compresses like a
+// game screen would: large areas of a single color, tiles and a few isolated
+// pixels
+std::vector<uint8_t> makeScreen();
+
+} // namespace bench
+
+#endif
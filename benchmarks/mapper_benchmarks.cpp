@@ -0,0 +1,31 @@
+#include "benchmark.h"
+#include "fixtures.h"
+#include "mapper.h"
+
+namespace {
+
+// runMMC3 benchmarks an MMC3 cartridge with 128kB of PRG ROM and 64kB of CHR
+// ROM, with all banks pointing to different pages
+template<class F>
+void runMMC3(bench::State& state, F access) {
+  bench::FakeConsole console(4, bench::makePrg(8, {}), bench::makeChr(8));
+  Mapper *mapper = console.get().getMapper();
+  for (int bank = 0; bank < 8; bank++) {
+    mapper->writePrg(0x8000, bank);
+    mapper->writePrg(0x8001, (3 * bank + 2) % 16);
+  }
+  state.start();
+  for (long i = 0; i < state.iterations; i++)
+    bench::keep(access(mapper, i));
+  state.stop();
+}
+
+} // namespace
+
+BENCHMARK("mmc3/readPrg", state) {
+  runMMC3(state, [](Mapper *m, long i) { return m->readPrg(0x8000 + (i & 0x7fff)); });
+}
+
+BENCHMARK("mmc3/readChr", state) {
+  runMMC3(state, [](Mapper *m, long i) { return m->readChr(i & 0x1fff); });
+}
@@ -0,0 +1,87 @@
+#include "benchmark.h"
+#include "fixtures.h"
+
+namespace {
+
+const int DOTS_PER_FRAME = PPU::CLOCK_CYCLE * (PPU::PRE_RENDER_SCAN_LINE + 1);
+// line used to benchmark sprite evaluation
+const int SPRITE_LINE = 100;
+
+void writeVram(PPU& ppu, uint16_t address, uint8_t value) {
+  ppu.writeRegister(0x2006, address >> 8);
+  ppu.writeRegister(0x2006, address & 0xff);
+  ppu.writeRegister(0x2007, value);
+}
+
+// fillScreen gives the PPU something to draw: all tiles differ, and so do the
+// palettes
+void fillScreen(PPU& ppu) {
+  for (int i = 0; i < 0x3c0; i++)
+    writeVram(ppu, 0x2000 + i, i * 7);
+  for (int i = 0x3c0; i < 0x400; i++)
+    writeVram(ppu, 0x2000 + i, i * 0x1b);
+  for (int i = 0; i < 0x20; i++)
+    writeVram(ppu, 0x3f00 + i, (i * 5) & 0x3f);
+}
+
+// setSprites places count sprites on SPRITE_LINE and hides the others below
+// the screen
+void setSprites(PPU& ppu, int count) {
+  ppu.writeRegister(0x2003, 0);
+  for (int i = 0; i < 64; i++) {
+    ppu.writeRegister(0x2004, i < count ? SPRITE_LINE - 4 : 0xf0); // y
+    ppu.writeRegister(0x2004, i);                                  // tile
+    ppu.writeRegister(0x2004, i & 0x23);                           // attributes
+    ppu.writeRegister(0x2004, i * 4);                              // x
+  }
+}
+
+// runFrames emulates whole frames with the PPU alone, mask being the value of
+// PPUMASK
+void runFrames(bench::State& state, uint8_t mask) {
+  bench::FakeConsole console(0, bench::makePrg(2, {}), bench::makeChr(1));
+  PPU& ppu = console.get().getPpu();
+  fillScreen(ppu);
+  setSprites(ppu, 8);
+  ppu.writeRegister(0x2001, mask);
+  state.start();
+  for (long i = 0; i < state.iterations; i++) {
+    for (int dot = 0; dot < DOTS_PER_FRAME; dot++)
+      ppu.step();
+  }
+  state.stop();
+  bench::keep(ppu.getFrameCount());
+}
+
+void runSpriteEvaluation(bench::State& state, int count) {
+  bench::FakeConsole console(0, bench::makePrg(2, {}), bench::makeChr(1));
+  PPU& ppu = console.get().getPpu();
+  setSprites(ppu, count);
+  state.start();
+  for (long i = 0; i < state.iterations; i++)
+    ppu.debugLoadSpriteData(SPRITE_LINE - 1);
+  state.stop();
+}
+
+} // namespace
+
+BENCHMARK("ppu/frame/rendering-off", state) {
+  runFrames(state, 0x00);
+}
+
+BENCHMARK("ppu/frame/rendering-on", state) {
+  // background and sprites, including on the leftmost 8 pixels
+  runFrames(state, 0x1e);
+}
+
+BENCHMARK("ppu/loadSpriteData/0-sprites", state) {
+  runSpriteEvaluation(state, 0);
+}
+
+BENCHMARK("ppu/loadSpriteData/8-sprites", state) {
+  runSpriteEvaluation(state, 8);
+}
+
+BENCHMARK("ppu/loadSpriteData/64-sprites", state) {
+  runSpriteEvaluation(state, 64);
+}
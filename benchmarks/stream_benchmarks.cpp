@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+#include "benchmark.h"
+#include "fixtures.h"
+#include "byte_aggregator.h"
+#include "screen_recorder.h"
+#include "screenstream.h"
+
+// Each iteration is one pixel, taken from the same synthetic screen over and
+// over
+
+namespace {
+const char *SCREEN_FILE = "benchmark_fixture.scrn";
+} // namespace
+
+namespace {
+void writeScreens(bench::State& state, utils::ScreenFormat format) {
+  std::vector<uint8_t> screen = bench::makeScreen();
+  utils::ScreenStream stream(SCREEN_FILE, utils::StreamMode::OUT, screen.size(), format);
+  state.start();
+  for (long i = 0; i < state.iterations; i++)
+    stream.write(screen[i % screen.size()]);
+  stream.close();
+  state.stop();
+  std::remove(SCREEN_FILE);
+}
+
+void readScreens(bench::State& state, utils::ScreenFormat format) {
+  std::vector<uint8_t> screen = bench::makeScreen();
+  utils::ScreenStream out(SCREEN_FILE, utils::StreamMode::OUT, screen.size(), format);
+  for (long i = 0; i < state.iterations; i++)
+    out.write(screen[i % screen.size()]);
+  out.close();
+
+  utils::ScreenStream in(SCREEN_FILE, utils::StreamMode::IN, screen.size());
+  state.start();
+  for (long i = 0; i < state.iterations; i++)
+    bench::keep(in.read());
+  state.stop();
+  std::remove(SCREEN_FILE);
+}
+} // namespace
+
+BENCHMARK("screenstream/write", state) {
+  writeScreens(state, utils::SCREEN_V2);
+}
+
+BENCHMARK("screenstream/read", state) {
+  readScreens(state, utils::SCREEN_V2);
+}
+
+// frames are read whole, but iterations still count pixels
+BENCHMARK("screenstream/read-frame", state) {
+  std::vector<uint8_t> screen = bench::makeScreen();
+  long frames = state.iterations / screen.size() + 1;
+  utils::ScreenStream out(SCREEN_FILE, utils::StreamMode::OUT, screen.size());
+  for (long i = 0; i < frames; i++)
+    out.writeFrame(screen.data());
+  out.close();
+
+  utils::ScreenStream in(SCREEN_FILE, utils::StreamMode::IN, screen.size());
+  std::vector<uint8_t> frame(screen.size());
+  state.start();
+  for (long i = 0; i < frames; i++)
+    bench::keep(in.readFrame(frame.data()));
+  state.stop();
+  std::remove(SCREEN_FILE);
+}
+
+// only the time spent by the emulation thread is measured, the log being
+// compressed and written in the background (until close)
+BENCHMARK("screen-recorder/write", state) {
+  std::vector<uint8_t> screen = bench::makeScreen();
+  utils::ScreenRecorder recorder(SCREEN_FILE, screen.size());
+  state.start();
+  for (long i = 0; i < state.iterations; i++)
+    recorder.write(screen[i % screen.size()]);
+  state.stop();
+  recorder.close();
+  std::remove(SCREEN_FILE);
+}
+
+BENCHMARK("screenstream/write-v1", state) {
+  writeScreens(state, utils::SCREEN_V1);
+}
+
+BENCHMARK("screenstream/read-v1", state) {
+  readScreens(state, utils::SCREEN_V1);
+}
+
+BENCHMARK("byte-aggregator/load", state) {
+  std::vector<uint8_t> screen = bench::makeScreen();
+  utils::ByteAggregator aggregator(utils::ByteAggregator::CAP);
+  state.start();
+  for (long i = 0; i < state.iterations; i++) {
+    uint8_t pixel = screen[i % screen.size()];
+    if (!aggregator.canLoad(pixel)) {
+      bench::keep(aggregator.aggregate().count);
+      aggregator.reset();
+    }
+    aggregator.load(pixel);
+  }
+  state.stop();
+}
+
+// loads whole frames at once (the last one being cut to the iterations)
+BENCHMARK("byte-aggregator/load-all", state) {
+  std::vector<uint8_t> screen = bench::makeScreen();
+  utils::ByteAggregator aggregator(utils::ByteAggregator::CAP);
+  std::string out;
+  state.start();
+  for (long i = 0; i < state.iterations; i += screen.size()) {
+    out.clear();
+    aggregator.loadAll(screen.data(), std::min((long)screen.size(), state.iterations - i), out);
+    bench::keep(out.size());
+  }
+  state.stop();
+}
+
+namespace {
+// encodeRuns returns the AggrBytes of iterations pixels of screen
+std::string encodeRuns(const std::vector<uint8_t>& screen, long iterations) {
+  utils::ByteAggregator aggregator(utils::ByteAggregator::CAP);
+  std::string out;
+  for (long i = 0; i < iterations; i += screen.size())
+    aggregator.loadAll(screen.data(), std::min((long)screen.size(), iterations - i), out);
+  utils::appendAggrBytes(out, aggregator.aggregate());
+  return out;
+}
+} // namespace
+
+BENCHMARK("byte-aggregator/read", state) {
+  std::vector<uint8_t> screen = bench::makeScreen();
+  std::istringstream in(encodeRuns(screen, state.iterations));
+  std::vector<uint8_t> frame(screen.size());
+  state.start();
+  long filled = 0;
+  size_t position = 0;
+  utils::AggrBytes run;
+  while (filled < state.iterations) {
+    in >> run;
+    for (int i = 0; i < run.count; i++) {
+      frame[position++] = run.val;
+      if (position == frame.size())
+        position = 0;
+    }
+    filled += run.count;
+  }
+  bench::keep(frame[0]);
+  state.stop();
+}
+
+BENCHMARK("byte-aggregator/decode", state) {
+  std::vector<uint8_t> screen = bench::makeScreen();
+  std::string runs = encodeRuns(screen, state.iterations);
+  std::vector<uint8_t> frame(screen.size());
+  const uint8_t *data = (const uint8_t*)runs.data();
+  const uint8_t *end = data + runs.size();
+  utils::AggrBytes run;
+  state.start();
+  for (long i = 0; i < state.iterations; i += frame.size())
+    bench::keep(utils::decodeAggrBytes(data, end, run, frame.data(), frame.size()));
+  state.stop();
+}
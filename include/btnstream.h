@@ -4,14 +4,16 @@
 #include <string>
 #include <fstream>
 #include <queue>
+#include <vector>
 
 #include "utilities.h"
 #include "streams.h"
+#include "mapped_file.h"
 
 namespace utils {
 // ButtonsBuffer is the compressed representation of a io_interface::ButtonSet
 struct ButtonsBuffer {
-  // count is the number of times this buffer "lasts", i.e. it is a
+  // count is the number of frames this buffer "lasts", i.e. it is a
   // convenient way to collapse several ButtonSets into one to save space
   long count;
   // buttons is a bit-array representation of which buttons were in use, in
@@ -25,7 +27,7 @@ inline std::ostream& operator<< (std::ostream& o, const ButtonsBuffer& buf) {
 
 // ResetBuffer is the compressed representation of the usage of the reset button
 struct ResetBuffer {
-  // count is the number of times this buffer "lasts", i.e. it is a
+  // count is the number of frames this buffer "lasts", i.e. it is a
   // convenient way to collapse several resets into one to save space
   long count;
   bool reset;
@@ -36,23 +38,93 @@ inline std::ostream& operator<< (std::ostream& o, const ResetBuffer& buf) {
 }
 
 
-// BtnStream is a wrapper around std::fstream that allows for the writing and reading
-// of ButtonsBuffer and ResetBuffer
+// FrameInput is the input of one frame: the buttons of both controllers (in
+// the order of ButtonsBuffer::buttons), and the reset button
+struct FrameInput {
+  uint8_t buttons[2];
+  bool reset;
+};
+
+inline bool operator== (const FrameInput& a, const FrameInput& b) {
+  return a.buttons[0] == b.buttons[0] && a.buttons[1] == b.buttons[1] && a.reset == b.reset;
+}
+
+// Movie holds the input of each frame of a session, so that it can be replayed
+// from any frame
+class Movie {
+  public:
+    // at returns the input of frame. Once the movie is over, the buttons of
+    // its last frame stay pressed (but not reset).
+    FrameInput at(long frame) const {
+      if (frame < (long)frames.size())
+        return frames[frame];
+      FrameInput last = frames.empty() ? FrameInput() : frames.back();
+      last.reset = false;
+      return last;
+    }
+    long size() const { return frames.size(); }
+    // append adds count frames of input
+    void append(const FrameInput& input, long count) { frames.insert(frames.end(), count, input); }
+    // the hash of the ROM the movie was recorded with (0 if unknown)
+    uint32_t romHash;
+    Movie(): romHash(0) {}
+  private:
+    std::vector<FrameInput> frames;
+};
+
+// BtnStream writes and reads button logs (movies). Files are read from memory
+// (see MappedFile).
+//
+// Logs are written in the v2 format: "MOV", the version (2) and the hash of
+// the ROM (see Mapper::romHash) on 4 bytes, then one record per run of
+// identical frames: the number of frames as a varint (7 bits per byte, lowest
+// first), the buttons of both controllers and the reset button (0 or 1). A
+// run of 0 frames ends the log.
+//
+// v1 logs, made of the 3 byte signature of a record ("BTN" or "RST", "END" at
+// the end) followed by a count of frames on 8 bytes and the buttons (of the
+// first controller) or reset byte, can still be read.
 class BtnStream {
   public:
+    // MAX_FRAMES is the length of the longest movie read (a day at 60 frames
+    // per second)
+    static const long MAX_FRAMES = 60L * 60 * 60 * 24;
     BtnStream(std::string fileName, StreamMode mode);
-    void write(ButtonsBuffer& buf);
-    void write(ResetBuffer& buf);
+    ~BtnStream();
+    BtnStream(const BtnStream&) = delete;
+    BtnStream& operator=(const BtnStream&) = delete;
+    // the ROM hash is written on close
+    void setRomHash(uint32_t hash) { romHash = hash; }
+    // writeFrame records the input of the next frame
+    void writeFrame(const FrameInput& input);
     void close();
-    void readAll(std::queue<ButtonsBuffer>& buttons, std::queue<ResetBuffer>& resets);
-    void read(std::queue<ButtonsBuffer>& buttons);
-    void read(std::queue<ResetBuffer>& resets);
+    // readMovie reads the whole log
+    Movie readMovie();
   private:
-    std::fstream stream;
     static const int SIG_SIZE = 3;
+    static const int ROM_HASH_OFFSET = 4;
+    static const char MOVIE_SIGNATURE[SIG_SIZE];
     const char btnSignature[SIG_SIZE] = {'B', 'T', 'N'};
     const char rstSignature[SIG_SIZE] = {'R', 'S', 'T'};
     const char endSignature[SIG_SIZE] = {'E', 'N', 'D'};
+    std::fstream stream;
+    MappedFile *file;
+    std::string fileName;
+    uint32_t romHash;
+    // run being written
+    FrameInput runInput;
+    long runLength;
+    void writeRun();
+    // next byte of file to read
+    const uint8_t *cursor;
+    // take copies the next size bytes of file to out
+    void take(void *out, size_t size);
+    uint64_t takeVarint();
+    void appendRun(Movie& movie, const FrameInput& input, uint64_t length);
+    void readAll(std::queue<ButtonsBuffer>& buttons, std::queue<ResetBuffer>& resets);
+    void read(std::queue<ButtonsBuffer>& buttons);
+    void read(std::queue<ResetBuffer>& resets);
+    Movie readV1();
 };
 
 } // namespace utils
@@ -1,6 +1,8 @@
 #ifndef BYTE_AGGREGATOR_H
 #define BYTE_AGGREGATOR_H
 
+#include <cstddef>
+#include <string>
 #include <vector>
 #include <stdint.h>
 #include <stdexcept>
@@ -24,6 +26,20 @@ struct AggrBytes {
 // Read and write AggrBytes
 std::ostream& operator<< (std::ostream& out, AggrBytes& ab);
 std::istream& operator>> (std::istream& in, AggrBytes& ab);
+// appendAggrBytes writes ab to out, encoded as operator<< does
+void appendAggrBytes(std::string& out, const AggrBytes& ab);
+
+// findRunEnd returns the index of the first byte after start that differs
+// from bytes[start] (or size if there is none), comparing 16 bytes at a time
+// where SSE2 is available
+size_t findRunEnd(const uint8_t *bytes, size_t start, size_t size);
+
+// decodeAggrBytes fills up to size bytes of out from the AggrBytes at data,
+// run being the one in progress (its count is what is left of it, so a run
+// can go on over several calls). It stops at end, or at a first byte of 0xff
+// (a value load refuses, used to end streams), and returns the number of
+// bytes filled (the bytes of out past them may have been written too).
+size_t decodeAggrBytes(const uint8_t *&data, const uint8_t *end, AggrBytes& run, uint8_t *out, size_t size);
 
 // ByteAggregator will aggregate indentical bytes into an AggrBytes. Reusable.
 class ByteAggregator {
@@ -34,6 +50,10 @@ class ByteAggregator {
     static const int CAP = 0xffff;
     // load a byte into the aggregator. Byte has to be <= MAX
     void load(uint8_t byte);
+    // loadAll loads size bytes at once, appending the runs it completes to
+    // out: the result is the same as loading them one by one and writing
+    // aggregate() each time canLoad fails. The last run is kept loaded.
+    void loadAll(const uint8_t *bytes, size_t size, std::string& out);
     // canLoad returns true if additional byte can be aggregated (equal to the
     // internal value, and capacity not exceeded)
     bool canLoad(uint8_t byte);
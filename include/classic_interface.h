@@ -2,14 +2,19 @@
 #define GUARD_NES_ENGINE_H
 
 #include <stdexcept>
+#include <atomic>
 #include <chrono>
 #include <array>
 #include <string>
+#include <thread>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "frame_pacer.h"
+#include "frame_timer.h"
 #include "shader_program.h"
+#include "triple_buffer.h"
 #include "logger.h"
 #include "io_interface.h"
 #include "version.h"
@@ -26,6 +31,14 @@ struct Color {
 const std::string WINDOW_NAME = 
   "Asten v" + std::to_string(ASTEN_VERSION_MAJOR) + "." + std::to_string(ASTEN_VERSION_MINOR);
 
+// ClassicInterface displays the screen in a window, and reads the buttons from
+// the keyboard.
+//
+// Frames are drawn by a render thread of their own, so that the emulation
+// never waits for the GPU or vsync: render() publishes the frame, which the
+// render thread picks up the next time it draws. Events are polled by the
+// thread that created the interface (as GLFW requires), which also samples
+// the keyboard.
 class ClassicInterface: public IOInterface {
   public:
     class Error: public std::runtime_error {
@@ -36,49 +49,70 @@ class ClassicInterface: public IOInterface {
     ~ClassicInterface();
     // Returns true if the window (the GLFW context) is about to close
     bool shouldClose();
-    // Calls rendering logic (flushes all changes to pixel color to the screen)
+    // Hands the frame over to the render thread, and polls events
     void render();
     // Changes the pixel at coordinates X, Y to color C, C being and index in
     // the NES palette. Coordinates are left to right, top to bottom ((0,0)
     // being in the top left).
     void colorPixel(int, int, int);
+    void setEmphasis(int);
     std::array<ButtonSet, 2> getButtons();
     // Returns true if the reset button is being pressed
     bool shouldReset();
+    // Returns true while the rewind button is being held
+    bool shouldRewind();
   private:
-    static constexpr Color palette[64] = {
-      Color(0x666666), Color(0x002A88), Color(0x1412A7), Color(0x3B00A4), Color(0x5C007E), Color(0x6E0040), Color(0x6C0600), Color(0x561D00),
-      Color(0x333500), Color(0x0B4800), Color(0x005200), Color(0x004F08), Color(0x00404D), Color(0x000000), Color(0x000000), Color(0x000000),
-      Color(0xADADAD), Color(0x155FD9), Color(0x4240FF), Color(0x7527FE), Color(0xA01ACC), Color(0xB71E7B), Color(0xB53120), Color(0x994E00),
-      Color(0x6B6D00), Color(0x388700), Color(0x0C9300), Color(0x008F32), Color(0x007C8D), Color(0x000000), Color(0x000000), Color(0x000000),
-      Color(0xFFFEFF), Color(0x64B0FF), Color(0x9290FF), Color(0xC676FF), Color(0xF36AFF), Color(0xFE6ECC), Color(0xFE8170), Color(0xEA9E22),
-      Color(0xBCBE00), Color(0x88D800), Color(0x5CE430), Color(0x45E082), Color(0x48CDDE), Color(0x4F4F4F), Color(0x000000), Color(0x000000),
-      Color(0xFFFEFF), Color(0xC0DFFF), Color(0xD3D2FF), Color(0xE8C8FF), Color(0xFBC2FF), Color(0xFEC4EA), Color(0xFECCC5), Color(0xF7D8A5),
-      Color(0xE4E594), Color(0xCFEF96), Color(0xBDF4AB), Color(0xB3F3CC), Color(0xB5EBF2), Color(0xB8B8B8), Color(0x000000), Color(0x000000),
-    };
     static const int ZOOM_FACTOR = 3;
     // Source code of the GL shaders
     static const std::string vertexShaderSource;
     static const std::string fragmentShaderSource;
 
-    static float adaptWidth(int);
-    static float adaptHeight(int);
     Logger log;
     GLFWwindow *window;
     ShaderProgram shaderProgram;
+    // Frame is what the emulation hands over to the render thread
+    struct Frame {
+      // palette index of each pixel, uploaded as is to the screen texture
+      uint8_t pixels[IOInterface::WIDTH * IOInterface::HEIGHT];
+      int emphasis;
+    };
+    // keys sampled into the input snapshot, one bit each
+    enum Key {
+      A_KEY, B_KEY, SELECT_KEY, START_KEY, UP_KEY, DOWN_KEY, LEFT_KEY, RIGHT_KEY,
+      RESET_KEY, REWIND_KEY, KEY_COUNT
+    };
+    static const int KEY_CODES[KEY_COUNT];
     void processInput();
+    void sampleKeys();
+    bool isPressed(Key key) { return (keys.load() >> key) & 1; }
     void initWindow();
     void initShaderProgram();
-    void initGrid();
-    void initColor();
+    void initTexture();
     void initVAO();
     void calculateFPS();
-    float *offsets;
-    float *colors;
-    float quad[12];
+    // renderLoop draws the latest frame whenever there is a new one, until
+    // the interface is destroyed (render thread)
+    void renderLoop();
+    void draw(const Frame&);
+    utils::TripleBuffer<Frame> frames;
+    // frame being filled by the emulation
+    Frame *frame;
+    std::thread renderThread;
+    std::atomic<bool> running;
+    // snapshot of the keys (bits of Key), taken after each poll of events
+    std::atomic<uint32_t> keys;
+    // the emulation is not throttled by vsync, and is paced here instead
+    // (Tab cycles through the speeds)
+    utils::FramePacer pacer;
+    bool speedKeyDown;
     int frameCounter;
+    // used to detect presses of the profiler key
+    bool profileKeyDown;
+    // times each frame (toggled with T), see utils::FrameTimer
+    utils::FrameTimer frameTimer;
+    bool timerKeyDown;
     std::chrono::time_point<std::chrono::high_resolution_clock> timeStamp;
-    unsigned int quadVBO, colorVBO, offsetVBO, VAO;
+    unsigned int screenTexture, quadVBO, VAO;
 };
 
 #endif
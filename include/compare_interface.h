@@ -3,42 +3,69 @@
 
 #include <array>
 #include <fstream>
-#include <queue>
 #include <string>
+#include <vector>
 
 #include "io_interface.h"
+#include "logger.h"
 #include "btnstream.h"
-#include "screenstream.h"
+#include "hashstream.h"
+#include "screen_prefetcher.h"
 
 
+// GOLDEN_DIFF_FILE is where CompareInterface shows a frame that does not match
+// its golden file
+const std::string GOLDEN_DIFF_FILE = "asten_golden_diff.ppm";
+
 // CompareInterface is a wrapper around another interface
 //
 // It will read from a saved monitor file, replay its button presses and compare
-// output
+// output. The output is either a screen log or a golden file (see
+// utils::HashStream), both compared frame by frame.
+//
+// Screen logs are decoded ahead of time by a thread of their own (see
+// utils::ScreenPrefetcher). As they are a stream of pixels, the frames compared
+// are those of the log: they match the frames of the screen unless rendering
+// was disabled at times, and the positions reported when they differ are then
+// only indicative.
 class CompareInterface: public IOInterface {
   public:
     CompareInterface(InterfaceType targetType, std::string btnLogPath, std::string scrnLogPath);
+    ~CompareInterface();
     bool shouldClose();
     bool shouldReset();
+    bool shouldRewind();
     void render();
     void colorPixel(int x, int y, int palette);
+    void setEmphasis(int emphasis);
+    void setRomHash(uint32_t hash);
     std::array<ButtonSet, 2> getButtons();
   private:
+    Logger log;
     IOInterface *target;
 
-    utils::BtnStream btnStream;
-    utils::ScreenStream screenStream;
-  
-    std::queue<utils::ButtonsBuffer> nextButtons;
-    std::queue<utils::ResetBuffer> nextResets;
-
-    long remainingCount;
-    std::array<ButtonSet, 2> currentButtons;
-    void loadNextButtons();
+    // only one of them is set, depending on the kind of file compared to
+    utils::ScreenPrefetcher *screenLog;
+    utils::HashStream *hashStream;
+    // pixels drawn since the start of the current frame of the screen log,
+    // cursor being the next one and frameEnd the end of the expected frame
+    std::vector<uint8_t> actual;
+    uint8_t *cursor;
+    uint8_t *frameEnd;
+    const uint8_t *expected;
+    long screenFrame;
+    void compareScreen();
+    void nextScreen();
+    // screen, and number of the frame being drawn, when comparing to a golden
+    // file
+    std::vector<uint8_t> frame;
+    long frameNumber;
+    void compareFrame();
+    void writeDiff(const uint8_t *expected);
 
-    long remainingRstCount;
-    bool currentReset;
-    void loadNextReset();
+    // the movie, and the frame whose input comes next (see getButtons)
+    utils::Movie movie;
+    long inputFrame;
 
     bool isDone;
 };
@@ -3,12 +3,16 @@
 
 
 #include <string>
+#include <chrono>
 
 #include "cpu.h"
 #include "ppu.h"
 #include "logger.h"
 #include "controller.h"
 #include "io_interface.h"
+#include "rewind.h"
+#include "state_buffer.h"
+#include "guest_profiler.h"
 
 
 class Mapper;
@@ -21,16 +25,56 @@ class Console {
     // results in the creation of button and screen log files, these will be
     // fetched from (or saved at) btnLogPath and scrnLogPath respectively
     Console(std::string romPath, InterfaceType type, std::string btnLogPath, std::string scrnLogPath);
+    ~Console();
+    // Consoles own their mapper and interface, and cannot be copied (see
+    // clone)
+    Console(const Console&) = delete;
+    Console& operator=(const Console&) = delete;
+    // clone returns a new console in the same state as this one, that can
+    // then be run independently. It uses interface (an IOSink if NULL), and
+    // starts without rewind nor run-ahead.
+    //
+    // The ROM is shared, and so are the RAMs until one of the consoles writes
+    // to them, so cloning is cheap.
+    Console *clone(IOInterface *interface = NULL);
     Mapper *getMapper();
     CPU& getCpu();
     PPU& getPpu();
     Controller& getLeftController();
     Controller& getRightController();
     IOInterface* getInterface();
-    // step simulates one clock cycle of the console
-    void step();
+    // step simulates one CPU instruction (or one cycle of a transfer during
+    // which the CPU waits) and the matching PPU cycles. It returns the number
+    // of CPU cycles emulated.
+    long step();
     // isRunning returns true if the console is currently active
     bool isRunning();
+    // save appends the state of the whole console to state, and load restores
+    // a state previously saved by the same console
+    void save(utils::StateBuffer& state);
+    void load(utils::StateBuffer& state);
+    // enableRewind starts recording the state every interval frames, keeping
+    // up to capacity entries. While the interface asks for it, the console
+    // then plays that history backwards.
+    void enableRewind(int interval = 2, int capacity = 9000);
+    // setRunAhead makes the console emulate frames extra frames ahead of each
+    // frame, with the same input, and only show the last one. This hides the
+    // input lag that games have internally, at the cost of emulating
+    // (frames + 1) frames per displayed frame. 0 disables it.
+    void setRunAhead(int frames);
+    // enableTrace starts recording the state of the console before each CPU
+    // instruction to fileName, which keeps the latest capacity instructions
+    // (see utils::TraceRing and asten-trace)
+    void enableTrace(std::string fileName, size_t capacity = 1 << 20);
+    // enableGuestProfiler starts profiling the emulated code, and returns the
+    // profiler (see GuestProfiler). It throws if asten was built without
+    // ASTEN_GUEST_PROFILER.
+    GuestProfiler *enableGuestProfiler();
+    // isOutputMuted returns true if the frame being emulated should not be
+    // sent to the interface
+    bool isOutputMuted();
+    // endFrame is called by the PPU once it has output a complete frame
+    void endFrame();
   private:
     Logger log;
     CPU cpu;
@@ -39,6 +83,34 @@ class Console {
     Controller rightController;
     Mapper *mapper;
     IOInterface *interface;
+    Rewinder *rewinder;
+    GuestProfiler *guestProfiler;
+    utils::TraceRing *trace;
+
+    // Run-ahead
+    int runAheadFrames;
+    // number of speculative frames that remain to be emulated before going
+    // back to the state saved in runAheadState
+    int speculativeFramesLeft;
+    bool outputMuted;
+    bool restorePending;
+    utils::StateBuffer runAheadState;
+    // used to measure the added cost of run-ahead
+    std::chrono::time_point<std::chrono::high_resolution_clock> runAheadStart;
+    std::chrono::nanoseconds runAheadTime;
+    int runAheadCount;
+
+    // Input is read from the interface once per frame, at its first step
+    bool inputPending;
+    // while the reset button is held, the CPU stays in reset
+    bool resetHeld;
+    void sampleInput();
+
+    // onFrame is called at the end of the step during which a frame was
+    // completed, when the whole console is in a consistent state
+    void onFrame();
+    // used by clone
+    Console(Console& source, IOInterface *interface);
 };
 
 #endif
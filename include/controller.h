@@ -6,6 +6,7 @@
 
 #include "logger.h"
 #include "io_interface.h"
+#include "state_buffer.h"
 
 // Buttons are the different possible buttons supported by the NES
 // The order is important, as the enum value is equal to the index in the button
@@ -32,12 +33,17 @@ class Controller {
     uint8_t read();
     // write the strobe value in the controller
     void write(uint8_t strobe);
-    // sets the internal register according to the buttons activated from the
-    // interface
+    // set takes a snapshot of the buttons activated on the interface, that
+    // the game sees the next time it strobes the controller (or right away
+    // while the strobe is set)
     void set(ButtonSet);
+    void save(utils::StateBuffer&);
+    void load(utils::StateBuffer&);
   private:
     Logger log;
+    // buttons are latched from snapshot when strobing
     bool buttons[8];
+    bool snapshot[8];
     // index is used to track which button to read next
     // the read order is:
     // A -> B -> select -> start -> up -> down -> left -> right
@@ -0,0 +1,58 @@
+#ifndef GUARD_COW_ARRAY_H
+#define GUARD_COW_ARRAY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "state_buffer.h"
+
+namespace utils {
+// CowArray is a fixed size array of bytes that can be shared with other arrays,
+// and is only copied when written to (copy on write).
+//
+// The array is split in pages: sharing it only copies a few pointers, and a
+// write only copies the page it falls in. Once a page has been copied, writing
+// to it again is as cheap as writing to a plain array.
+//
+// Shared pages are never written to, so arrays sharing pages can be used from
+// different threads.
+class CowArray {
+  public:
+    static const size_t PAGE_SIZE = 0x400;
+    // CowArray creates an array of size bytes, all set to 0
+    CowArray(size_t size);
+    // copies share the pages of source: both arrays then copy the pages they
+    // write to (which is why source cannot be const)
+    CowArray(CowArray& source);
+    CowArray(const CowArray&) = delete;
+    CowArray& operator=(const CowArray&) = delete;
+    uint8_t read(size_t index) const {
+      return pages[index / PAGE_SIZE][index % PAGE_SIZE];
+    }
+    void write(size_t index, uint8_t value) {
+      size_t page = index / PAGE_SIZE;
+      if (!owned[page])
+        own(page);
+      pages[page][index % PAGE_SIZE] = value;
+    }
+    size_t size() const;
+    // save appends the content of the array to state, and load restores it
+    void save(StateBuffer& state) const;
+    void load(StateBuffer& state);
+  private:
+    size_t bytes;
+    // pages holds the address of each page, and owners keeps them alive
+    std::vector<uint8_t*> pages;
+    std::vector<std::shared_ptr<uint8_t>> owners;
+    // owned is true for the pages that are not shared with any other array
+    std::vector<uint8_t> owned;
+
+    // own makes sure page is not shared anymore, copying it if needed
+    void own(size_t page);
+    size_t pageBytes(size_t page) const;
+};
+} // namespace utils
+
+#endif
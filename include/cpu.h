@@ -9,12 +9,17 @@
 #include "memory.h"
 #include "utilities.h"
 #include "logger.h"
+#include "state_buffer.h"
+#include "guest_profiler.h"
+#include "trace_ring.h"
 
 
 class Console;
 class CPU {
 public:
   CPU(Console&);
+  // creates a copy of other for another console
+  CPU(Console&, CPU& other);
   CPUMemory& getMemory();
   long step();
   void waitFor(int);
@@ -25,9 +30,30 @@ public:
   // used to force the pc value for tests
   void debugSetPc(uint16_t);
   CPUStateData dumpState();
+  // getInstructionCount returns the number of instructions executed since the
+  // CPU was created
+  long getInstructionCount();
+  // setTrace makes the CPU record the state before each instruction to trace
+  // (or stop recording if NULL)
+  void setTrace(utils::TraceRing *trace);
+  // disassemble returns the text of the instruction at pc, as found in
+  // nestest.log (without the values read from memory): "JMP $C5F5". It starts
+  // with a * for unofficial instructions.
+  static std::string disassemble(uint16_t pc, uint8_t opcode, uint8_t low, uint8_t high);
+  // instructionSize returns the number of bytes of an instruction, opcode
+  // included
+  static int instructionSize(uint8_t opcode) { return instructionSizes[opcode]; }
+  // setGuestProfiler makes the CPU report what it executes to profiler (when
+  // built with ASTEN_GUEST_PROFILER)
+  void setGuestProfiler(GuestProfiler *profiler);
+  // save appends the CPU state (registers and RAM) to state, and load restores
+  // it
+  void save(utils::StateBuffer& state);
+  void load(utils::StateBuffer& state);
 private:
   Logger log;
   CPUMemory mem;
+  Console& console;
   uint8_t A, X, Y;                // registers
   uint8_t sp;                     // stack pointer
   uint16_t pc;                    // program counter
@@ -35,6 +61,11 @@ private:
   // TODO: store only the % 341 version?
   long clock;                     // internal CPU clock (total number of cycles)
   int cyclesToWait;
+  long instructionCount;
+  // number of cycles since power on (clock wraps around)
+  long cycleCount;
+  utils::TraceRing *trace;
+  GuestProfiler *guestProfiler;
   // debug
   uint8_t latestInstruction;
   enum InterruptType: uint8_t {
@@ -67,7 +98,7 @@ private:
   };
   // instruction table
   typedef void (CPU::*cpuInstruction)(const InstructionInfo&);
-  cpuInstruction instructionTable[256];
+  static const cpuInstruction instructionTable[256];
   // addressing mode for each of the 256 instructions
   static constexpr uint8_t instructionModes[256] = {
     6, 7, 6, 7, 11, 11, 11, 11, 6, 5, 4, 5, 1, 1, 1, 1,
@@ -144,7 +175,27 @@ private:
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
     1, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 0,
   };
+  // whether each instruction is part of the official instruction set
+  static constexpr bool instructionOfficial[256] = {
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 1, 0, 0, 1, 1, 0,
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0,
+    1, 1, 0, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0,
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0,
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0,
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0,
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0,
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0,
+    0, 1, 0, 0, 1, 1, 1, 0, 1, 0, 1, 0, 1, 1, 1, 0,
+    1, 1, 0, 0, 1, 1, 1, 0, 1, 1, 1, 0, 0, 1, 0, 0,
+    1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0,
+    1, 1, 0, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0,
+    1, 1, 0, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0,
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0,
+    1, 1, 0, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0,
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0,
+  };
   // private functions
+  void recordTrace();
   uint8_t getFlags() const;
   void setFlags(uint8_t);
   uint8_t nextByte();
@@ -0,0 +1,49 @@
+#ifndef GUARD_FRAME_PACER_H
+#define GUARD_FRAME_PACER_H
+
+#include <chrono>
+#include <ostream>
+
+#include "frame_timer.h"
+
+namespace utils {
+
+// NTSC_FRAME_RATE is the number of frames per second of an NTSC NES
+const double NTSC_FRAME_RATE = 60.0988;
+
+// FramePacer keeps frames at a steady rate: wait() is called once per frame,
+// and returns when the next frame is due.
+//
+// It sleeps until shortly before that, and spins for the rest, as sleeping is
+// not precise enough. Frames are due at fixed times from a start point rather
+// than relative to the previous one, so that a late frame is caught up by the
+// next ones instead of the error accumulating. After a long stall, it starts
+// over instead of running fast.
+class FramePacer {
+  public:
+    explicit FramePacer(double frameRate = NTSC_FRAME_RATE);
+    // setSpeed runs speed times faster than the frame rate, 0 meaning as fast
+    // as possible
+    void setSpeed(int speed);
+    int getSpeed() const { return speed; }
+    void wait();
+    // writeStats writes how late frames started
+    void writeStats(std::ostream&);
+  private:
+    typedef std::chrono::steady_clock Clock;
+    // time spent spinning before a frame is due
+    static const int SPIN_MICROSECONDS = 2000;
+    // lateness from which the pacer starts over
+    static const int RESYNC_MICROSECONDS = 100000;
+    double frameRate;
+    int speed;
+    Clock::time_point start;
+    long frames;
+    // lateness of the frames, in microseconds
+    Histogram jitter;
+    void resync(Clock::time_point now);
+};
+
+} // namespace utils
+
+#endif
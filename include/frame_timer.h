@@ -0,0 +1,91 @@
+#ifndef GUARD_FRAME_TIMER_H
+#define GUARD_FRAME_TIMER_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+// FRAME_TIMES_FILE is where the frame time summary is written at exit
+const std::string FRAME_TIMES_FILE = "asten_frame_times.txt";
+
+// Histogram counts values (durations in microseconds) with a bounded relative
+// error, as HdrHistogram does: values below 64 are exact, and larger ones fall
+// in 32 buckets per power of two (about 3% wide).
+class Histogram {
+  public:
+    Histogram();
+    void record(uint64_t value);
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maxValue; }
+    // percentile returns the value below which p (in [0, 1]) of the values
+    // are
+    uint64_t percentile(double p) const;
+  private:
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t maxValue;
+    static size_t bucketOf(uint64_t value);
+    // highest value of a bucket
+    static uint64_t upperBound(size_t bucket);
+};
+
+// FramePhase are the parts a frame of the frontend is split in
+enum FramePhase {
+  // running the console until the frame is complete
+  EMULATE_PHASE,
+  // handing the frame over to be displayed
+  PRESENT_PHASE,
+  // polling events and reading the keyboard
+  INPUT_PHASE,
+  // waiting for the next frame to be due, which does not count against the
+  // budget
+  IDLE_PHASE,
+  PHASE_COUNT
+};
+
+// FrameTimer measures the wall time of each frame and of its phases. Frames
+// that exceed the budget are reported as they happen.
+//
+// The frontend calls startPhase when switching phases, and endFrame once the
+// frame is on screen, which also starts the emulation of the next one.
+class FrameTimer {
+  public:
+    // budget is in microseconds
+    explicit FrameTimer(uint64_t budget = 16667);
+    void startPhase(FramePhase);
+    // endFrame returns true if the frame took longer than the budget (idle
+    // time excluded)
+    bool endFrame();
+    // toggle stops or resumes timing
+    void toggle();
+    bool isEnabled() const { return enabled; }
+    // writeSummary writes the percentiles of frame and phase times, and the
+    // latest slow frames
+    void writeSummary(std::ostream&);
+  private:
+    typedef std::chrono::steady_clock Clock;
+    // number of slow frame reports kept for the summary
+    static const size_t SLOW_FRAMES = 32;
+    uint64_t budget;
+    bool enabled;
+    // false until a frame boundary is seen (after creation or toggling)
+    bool started;
+    FramePhase phase;
+    Clock::time_point phaseStart;
+    uint64_t current[PHASE_COUNT];
+    Histogram frames;
+    Histogram phases[PHASE_COUNT];
+    long frameCount;
+    long slowFrameCount;
+    std::vector<std::string> slowFrames;
+    void closePhase(Clock::time_point now);
+    std::string describeFrame(uint64_t duration);
+};
+
+} // namespace utils
+
+#endif
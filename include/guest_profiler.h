@@ -0,0 +1,97 @@
+#ifndef GUARD_GUEST_PROFILER_H
+#define GUARD_GUEST_PROFILER_H
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class Console;
+// GuestProfiler attributes the cycles of the emulated CPU to the 6502 code
+// that spends them. It records:
+// - a histogram of cycles per byte of PRG ROM (resolved through the current
+//   banks of the mapper) and per address of code running from RAM
+// - a histogram of the executed opcodes
+// - a call tree, built from JSR/RTS and interrupts/RTI
+//
+// Locations are written BB:$AAAA, BB being the 8kB bank of PRG ROM and $AAAA
+// the CPU address ("RAM" for code outside PRG ROM).
+//
+// The CPU only calls the profiler when built with ASTEN_GUEST_PROFILER (see
+// Console::enableGuestProfiler), so that it costs nothing otherwise.
+class GuestProfiler {
+  public:
+    // kinds of entries in the call tree
+    enum EntryKind {
+      CALL,
+      NMI,
+      IRQ,
+      BRK
+    };
+    GuestProfiler(Console&);
+    // onFetch is called before the instruction at pc is executed, and
+    // onInstruction once it was, pc and sp being the new program counter and
+    // stack pointer
+    void onFetch(uint16_t pc) { lastPc = pc; }
+    void onInstruction(uint8_t opcode, int cycles, uint16_t pc, uint8_t sp);
+    // onWait counts cycles during which the CPU did not execute anything
+    // (transfers, interrupts)
+    void onWait(int cycles);
+    void onInterrupt(EntryKind kind, uint16_t handler, uint8_t sp);
+    void onReset();
+    // writeReport writes the hottest banks, locations and opcodes
+    void writeReport(std::ostream& out, int top = 40);
+    // writeFolded writes the call tree as folded stacks, as used by
+    // flamegraph.pl and speedscope
+    void writeFolded(std::ostream& out);
+  private:
+    static const int BANK_SIZE = 0x2000;
+    // functions are identified by the kind of entry, bank and address of
+    // their first instruction
+    static const uint32_t RAM_BANK = 0xff;
+    static const size_t MAX_DEPTH = 256;
+    struct Node {
+      uint32_t function;
+      int parent;
+      std::map<uint32_t, int> children;
+      uint64_t cycles;
+    };
+    struct Frame {
+      int node;
+      // value of the stack pointer once the function returned
+      uint8_t returnSp;
+    };
+    Console& console;
+    uint16_t lastPc;
+    uint64_t totalCycles;
+    uint64_t instructions;
+    // cycles per byte of PRG ROM (and the CPU address it was last seen at),
+    // and per address below $8000
+    std::vector<uint64_t> romCycles;
+    std::vector<uint16_t> romAddresses;
+    std::vector<uint64_t> ramCycles;
+    uint64_t opcodeCounts[256];
+    uint64_t opcodeCycles[256];
+    std::vector<Node> nodes;
+    std::vector<Frame> stack;
+    int currentNode;
+
+    // count attributes cycles to the current location and function
+    void count(int cycles);
+    uint32_t locate(uint16_t address);
+    void enter(EntryKind kind, uint16_t address, uint8_t returnSp);
+    void leave(uint8_t sp);
+    static std::string name(uint32_t function);
+    void writeFolded(std::ostream& out, int node, std::string path);
+};
+
+// GUEST_PROFILE calls a method of profiler if it is set, when built with
+// ASTEN_GUEST_PROFILER, and does nothing otherwise
+#ifdef ASTEN_GUEST_PROFILER
+#define GUEST_PROFILE(profiler, call) if (profiler != NULL) profiler->call
+#else
+#define GUEST_PROFILE(profiler, call)
+#endif
+
+#endif
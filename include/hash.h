@@ -0,0 +1,15 @@
+#ifndef GUARD_HASH_H
+#define GUARD_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace utils {
+// crc32 returns the CRC-32 (as used by zip and ROM databases) of size bytes
+uint32_t crc32(const uint8_t *data, size_t size);
+// hash64 returns a 64-bit hash of size bytes, fast enough to hash every frame
+// (it reads 8 bytes at a time, in the manner of xxHash64)
+uint64_t hash64(const uint8_t *data, size_t size);
+} // namespace utils
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef GUARD_HASHSTREAM_H
+#define GUARD_HASHSTREAM_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "streams.h"
+#include "mapped_file.h"
+
+namespace utils {
+// GOLDEN_EXTENSION is the extension of golden files
+const std::string GOLDEN_EXTENSION = ".golden";
+
+// HashStream writes and reads golden files, which hold a hash of each frame
+// (see hash64) rather than its pixels. A frame is then compared with a
+// single hash. Every keyframeInterval frames (if not 0), the whole frame is
+// kept as well, so that a mismatch on such a frame can be shown.
+//
+// Frames are the whole screen, as shown each time the interface renders:
+// pixels that were not drawn (while rendering is disabled) keep their color.
+//
+// A file is made of a header ("HSH", the version (1), then the screen size,
+// the keyframe interval and the hash of the ROM, all on 4 bytes) followed by
+// the hash of each frame on 8 bytes, keyframes being followed by their
+// pixels. Integers are little endian.
+class HashStream {
+  public:
+    // DEFAULT_KEYFRAME_INTERVAL keeps a frame per second
+    static const int DEFAULT_KEYFRAME_INTERVAL = 60;
+    HashStream(std::string fileName, StreamMode mode, int screenSize, int keyframeInterval = 0);
+    ~HashStream();
+    HashStream(const HashStream&) = delete;
+    HashStream& operator=(const HashStream&) = delete;
+    // isGoldenFile returns true if fileName was written by a HashStream (as
+    // opposed to a ScreenStream)
+    static bool isGoldenFile(std::string fileName);
+    // writeFrame writes the hash of screenSize pixels, and the pixels
+    // themselves for keyframes
+    void writeFrame(const uint8_t *pixels);
+    // readFrame reads the hash of the next frame, and sets keyframe to its
+    // pixels if they were kept (NULL otherwise). It returns false once all
+    // the frames were read.
+    bool readFrame(uint64_t& hash, const uint8_t *&keyframe);
+    int getKeyframeInterval() const { return keyframeInterval; }
+    // the ROM hash is written on close, and is 0 if it was never set
+    void setRomHash(uint32_t hash) { romHash = hash; }
+    uint32_t getRomHash() const { return romHash; }
+    // close must be called once all the frames were written
+    void close();
+  private:
+    static const char SIGNATURE[3];
+    static const int HEADER_SIZE = 16;
+    static const int ROM_HASH_OFFSET = 12;
+    std::fstream stream;
+    MappedFile *file;
+    std::string fileName;
+    int screenSize;
+    int keyframeInterval;
+    uint32_t romHash;
+    long frameCount;
+    // next byte of file to read
+    const uint8_t *cursor;
+};
+} // namespace utils
+
+#endif
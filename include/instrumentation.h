@@ -0,0 +1,73 @@
+#ifndef GUARD_INSTRUMENTATION_H
+#define GUARD_INSTRUMENTATION_H
+
+#include <bitset>
+#include <cstdint>
+#include <ostream>
+
+namespace utils {
+
+// DebugCounter are the events counted by the debug instrumentation
+enum DebugCounter {
+  CPU_READS,
+  CPU_WRITES,
+  PPU_READS,
+  PPU_WRITES,
+  BANK_SWITCHES,
+  INTERRUPTS,
+  COUNTER_COUNT
+};
+
+// Bus is the memory bus a watchpoint is set on
+enum Bus {
+  CPU_BUS,
+  PPU_BUS
+};
+
+// Instrumentation holds the counters and watchpoints of the debug build. It is
+// meant to be used through the DEBUG_ macros below, from the thread running
+// the emulation only.
+class Instrumentation {
+  public:
+    static Instrumentation& get() { return instance; }
+    void count(DebugCounter counter) { counters[counter]++; }
+    // watch logs every access to address on bus from now on
+    void watch(Bus bus, uint16_t address) { watched[bus].set(address); }
+    void onRead(Bus bus, uint16_t address) {
+      if (watched[bus][address])
+        report(bus, address, false, 0);
+    }
+    void onWrite(Bus bus, uint16_t address, uint8_t value) {
+      if (watched[bus][address])
+        report(bus, address, true, value);
+    }
+    // printCounters writes the value of all the counters
+    void printCounters(std::ostream&);
+  private:
+    Instrumentation();
+    static Instrumentation instance;
+    uint64_t counters[COUNTER_COUNT];
+    std::bitset<0x10000> watched[2];
+    void report(Bus bus, uint16_t address, bool write, uint8_t value);
+};
+
+} // namespace utils
+
+// Debug instrumentation (debug logs in hot paths, counters and watchpoints) is
+// only compiled in with the ASTEN_DEBUG_INSTRUMENTATION option. Otherwise, it
+// compiles to nothing, arguments included (they are still type checked).
+//
+// DEBUG_LOG(log) starts a debug message: DEBUG_LOG(log) << hex(a) << "\n";
+#ifdef ASTEN_DEBUG_INSTRUMENTATION
+#define DEBUG_LOG(logger) LOG_DEBUG(logger)
+#define DEBUG_COUNT(counter) utils::Instrumentation::get().count(utils::counter)
+#define DEBUG_WATCH_READ(bus, address) utils::Instrumentation::get().onRead(utils::bus, address)
+#define DEBUG_WATCH_WRITE(bus, address, value) utils::Instrumentation::get().onWrite(utils::bus, address, value)
+#else
+#define DEBUG_LOG(logger) if (true) {} else (logger).debug()
+#define DEBUG_COUNT(counter)
+#define DEBUG_WATCH_READ(bus, address)
+#define DEBUG_WATCH_WRITE(bus, address, value)
+#endif
+
+#endif
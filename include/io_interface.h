@@ -19,6 +19,9 @@ enum InterfaceType {
   // DEBUG wraps a classic interface and uses a file to replay button presses
   // It then compares the output with whatever was in the file
   DEBUG_INTERFACE,
+  // PLAYBACK has no window: it uses a file to replay button presses, and
+  // optionally saves the output to another file
+  PLAYBACK,
 };
 
 
@@ -34,6 +37,10 @@ struct ButtonSet {
   utils::ButtonsBuffer marshal(long count);
   // unmarshal unpacks a ButtonsBuffer into a ButtonSet, returning count
   long unmarshal(utils::ButtonsBuffer& buf);
+  // encode returns the buttons packed as in ButtonsBuffer, and decode unpacks
+  // them
+  uint8_t encode();
+  static ButtonSet decode(uint8_t buttons);
 };
 
 // IOInterface describes what any I/O implementation should be able to do in
@@ -44,21 +51,36 @@ class IOInterface {
     // colorPixel's x should be < WIDTH and y < HEIGHT
     static const int WIDTH = 256;
     static const int HEIGHT = 240;
+    // PALETTE is the RGB color (0xRRGGBB) of each palette value
+    static const uint32_t PALETTE[64];
     // btnLogPath and scrnLogPath will be used in the case were the interface
     // of type type creates or reads from button and screen log files
     static IOInterface* newIOInterface(InterfaceType type, std::string btnLogPath, std::string scrnLogPath);
+    virtual ~IOInterface() {};
     // shouldClose returns true if the interface received the instruction to
     // close down
     virtual bool shouldClose() = 0;
     // shouldReset returns true if the interface received the instruction to
-    // reset
+    // reset. Like getButtons, it is called once per frame.
     virtual bool shouldReset() = 0;
+    // shouldRewind returns true while the interface asks for the session to be
+    // played backwards
+    virtual bool shouldRewind() = 0;
     // render outputs all the pixels to the screen
     virtual void render() = 0;
     // colorPixel sets the color of pixel in position x, y
     // palette should be < 64 (the maximum number of colors supported by a NES)
     virtual void colorPixel(int x, int y, int palette) = 0;
-    // getButtons returns which buttons are enabled for each controller
+    // setEmphasis sets the color emphasis of the frame being drawn, as the
+    // red, green and blue bits of PPUMASK (bits 0, 1 and 2 of emphasis).
+    // Interfaces that do not display anything can ignore it.
+    virtual void setEmphasis(int) {}
+    // setRomHash tells the interface which ROM is running (see
+    // Mapper::romHash), for the logs it writes or checks
+    virtual void setRomHash(uint32_t) {}
+    // getButtons returns which buttons are enabled for each controller. The
+    // console calls it once per frame, and games see the result when they
+    // strobe the controllers.
     virtual std::array<ButtonSet, 2> getButtons() = 0;
 };
 
@@ -68,6 +90,7 @@ class IOSink: public IOInterface {
   public:
     bool shouldClose() { return false; };
     bool shouldReset() { return false; };
+    bool shouldRewind() { return false; };
     void render() {};
     void colorPixel(int, int, int) {};
     std::array<ButtonSet, 2> getButtons() { return std::array<ButtonSet, 2>(); };
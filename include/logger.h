@@ -1,10 +1,13 @@
 #ifndef GUARD_LOGGER_H
 #define GUARD_LOGGER_H
 
-#include <string>
+#include <cstring>
 #include <iostream>
-#include <fstream>
 #include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <type_traits>
 
 
 enum LogLevel {
@@ -15,36 +18,107 @@ enum LogLevel {
 };
 
 
+// Logger writes messages to the standard output or to a file.
+//
+// Logging does not format anything on the calling thread: each thread appends
+// binary records (a timestamp, the level, and the raw arguments) to a lock free
+// ring buffer of its own, and a background thread formats them and writes them
+// to the outputs. Each output is only opened once, and shared by all the
+// loggers writing to it.
+//
+// A record starts with debug(), info()... and is handed to the background
+// thread once an argument ends with a new line (or when the thread starts
+// another record). Plain values (ints, hex(), state structures...) are copied
+// as is and formatted later, as are strings (including char arrays, which may
+// not outlive the call) unless marked with LOG_LITERAL; anything else is
+// formatted immediately. Strings are cut after 4096 characters, which is
+// marked in the output.
+//
+// What was logged is still written if the program ends with std::terminate
+// (an uncaught exception for instance).
+//
+// Arguments are evaluated even if the level is disabled, unless the message is
+// started with LOG_DEBUG or LOG_INFO (see below):
+//   LOG_DEBUG(log) << dumpState() << "\n";
 class Logger {
   public:
+    // Formatter writes the value stored at the given address to a stream
+    typedef void (*Formatter)(std::ostream&, const void*);
+
     Logger& debug();
     Logger& info();
     Logger& warn();
     Logger& error();
-    Logger(const Logger&);
     static Logger getLogger(std::string, std::string outputFile = "");
     Logger& setLevel(LogLevel);
     Logger& toggleHeader();
+    // isEnabled returns true if messages of level l are output
+    bool isEnabled(LogLevel l) const { return l >= level; }
+    // flush blocks until everything logged so far (by any thread) is written
+    static void flush();
+    // MAX_VALUE is the size of the largest plain value copied as is: larger
+    // ones are formatted immediately
+    static const size_t MAX_VALUE = 4096;
     // operator
     template<class T>
     Logger& operator<< (const T& msg) {
       if (outputEnabled)
-        out << msg;
+        append(msg, std::integral_constant<bool, std::is_trivially_copyable<T>::value && sizeof(T) <= MAX_VALUE>());
       return *this;
     }
+    // Literal is a string that lives as long as the program, which is
+    // referenced instead of being copied (see LOG_LITERAL)
+    struct Literal {
+      const char *text;
+    };
+    Logger& operator<< (Literal);
+    Logger& operator<< (const char*);
+    Logger& operator<< (char*);
+    Logger& operator<< (const std::string&);
+    Logger& operator<< (std::ostream& (*)(std::ostream&));
+    Logger& operator<< (std::ios_base& (*)(std::ios_base&));
   private:
-    Logger(std::string, std::string);
+    Logger(std::string, int);
     std::string name;
-    std::string outputFileName;
+    // id identifies the logger (and the output it writes to) in records
+    int id;
     LogLevel level;
-    std::streambuf *buf;
-    std::ofstream of;
-    std::ostream out;
     bool outputEnabled = true;
     bool headerEnabled = true;
     static std::map<std::string, Logger> loggerMap;
-    void outputHeader(LogLevel);
+    // registryLock protects loggerMap
+    static std::mutex registryLock;
     Logger& log(LogLevel);
+
+    template<class T>
+    static void format(std::ostream& o, const void* value) {
+      typename std::aligned_storage<sizeof(T), alignof(T)>::type copy;
+      std::memcpy(&copy, value, sizeof(T));
+      o << *reinterpret_cast<const T*>(&copy);
+    }
+    template<class T>
+    void append(const T& msg, std::true_type) {
+      appendValue(&Logger::format<T>, &msg, sizeof(T));
+    }
+    template<class T>
+    void append(const T& msg, std::false_type) {
+      std::ostringstream formatted;
+      formatted << msg;
+      std::string s = formatted.str();
+      appendString(s.data(), s.size());
+    }
+    void appendValue(Formatter, const void*, size_t);
+    void appendLiteral(const char*);
+    void appendString(const char*, size_t);
 };
 
+// LOG_DEBUG(log) and LOG_INFO(log) start a message whose arguments are only
+// evaluated if the level is enabled
+#define LOG_DEBUG(logger) if (!(logger).isEnabled(DEBUG)) {} else (logger).debug()
+#define LOG_INFO(logger) if (!(logger).isEnabled(INFO)) {} else (logger).info()
+
+// LOG_LITERAL(text) logs a string literal without copying it. Only literals
+// compile: log.info() << LOG_LITERAL("done\n");
+#define LOG_LITERAL(text) Logger::Literal{"" text}
+
 #endif
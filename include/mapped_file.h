@@ -0,0 +1,31 @@
+#ifndef GUARD_MAPPED_FILE_H
+#define GUARD_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace utils {
+// MappedFile maps a whole file in memory, read only, so that readers can
+// decode it in place instead of copying it through a stream. Small files are
+// simply read, which is cheaper than setting up a mapping.
+class MappedFile {
+  public:
+    MappedFile(std::string fileName);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    const uint8_t *data() const { return bytes; }
+    const uint8_t *end() const { return bytes + length; }
+    size_t size() const { return length; }
+  private:
+    static const size_t MAP_THRESHOLD = 64 * 1024;
+    const uint8_t *bytes;
+    size_t length;
+    // holds small files, that are not mapped
+    std::vector<uint8_t> buffer;
+};
+} // namespace utils
+
+#endif
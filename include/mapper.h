@@ -6,12 +6,15 @@
 #include <string>
 #include <fstream>
 #include <iterator>
+#include <memory>
 #include <vector>
 #include <iomanip>
 #include <iostream>
 
 #include "logger.h"
 #include "utilities.h"
+#include "state_buffer.h"
+#include "cow_array.h"
 
 
 struct NESHeader {
@@ -41,6 +44,7 @@ inline std::ostream& operator<< (std::ostream& out, const NESHeader& h) {
 
 class PPUMirror {
   public:
+    virtual ~PPUMirror() {};
     virtual int getTable(int) = 0;
     static PPUMirror* fromId(int);
     static const int OFFSET = 0x2000;
@@ -73,22 +77,53 @@ class Mapper {
     virtual void writeChr(uint16_t, uint8_t) = 0;
     // Call to signify that PPU A12 had a rising edge
     virtual void clockIRQCounter() = 0;
+    // prgRomOffset returns the offset in PRG ROM of the byte the CPU reads at
+    // address (>= $8000), given the current banks
+    virtual int prgRomOffset(uint16_t address) = 0;
     static Mapper *fromNesFile(Console& c, std::string fileName);
+    // romHash returns the CRC-32 of the PRG and CHR ROM, which identifies the
+    // game
+    uint32_t romHash();
+    virtual ~Mapper();
     // mirrorAddress is used to get the right nametable depending on the
     // mirroring
     uint16_t mirrorAddress(uint16_t);
+    // save appends the writable memories of the cartridge (PRG RAM and CHR
+    // RAM) to state, and load restores them. Mappers with internal registers
+    // extend both to include them.
+    virtual void save(utils::StateBuffer&);
+    virtual void load(utils::StateBuffer&);
+    // clone returns a copy of the mapper for another console. Both share the
+    // ROM, and the RAM until one of them writes to it.
+    virtual Mapper *clone(Console&) = 0;
   protected:
     Logger log;
+    NESHeader header;
     PPUMirror* mirror;
     Console& console;
-    Mapper(Console&, NESHeader, const std::vector<uint8_t>&);
+    Mapper(Console&, NESHeader, std::shared_ptr<const std::vector<uint8_t>>);
+    Mapper(Console&, Mapper& other);
     static const int PRG_ROM_UNIT = 0x4000;
     static const int CHR_ROM_UNIT = 0x2000;
     static const int PRG_RAM_UNIT = 0x2000;
-    uint8_t *prgRom;
-    uint8_t *prgRam;
-    uint8_t *chrRom;
+    // rom holds the PRG ROM followed by the CHR ROM, and is never written to
+    std::shared_ptr<const std::vector<uint8_t>> rom;
+    const uint8_t *prgRom;
+    const uint8_t *chrRom;
     int prgRomSize;
+    utils::CowArray prgRam;
+    // chrRam replaces the CHR ROM for cartridges that have none (it is empty
+    // otherwise)
+    utils::CowArray chrRam;
+    // readChrMemory and writeChrMemory access CHR RAM if the cartridge has
+    // some, and CHR ROM otherwise (writes to CHR ROM are ignored)
+    uint8_t readChrMemory(int address) {
+      return chrRam.size() ? chrRam.read(address) : chrRom[address];
+    }
+    void writeChrMemory(int address, uint8_t value) {
+      if (chrRam.size())
+        chrRam.write(address, value);
+    }
 };
 
 class NROMMapper: public Mapper {
@@ -99,7 +134,10 @@ class NROMMapper: public Mapper {
     void writeChr(uint16_t p, uint8_t v);
     // Does nothing
     void clockIRQCounter();
-    NROMMapper(Console&, NESHeader, const std::vector<uint8_t>&);
+    int prgRomOffset(uint16_t p);
+    NROMMapper(Console&, NESHeader, std::shared_ptr<const std::vector<uint8_t>>);
+    NROMMapper(Console&, NROMMapper& other);
+    Mapper *clone(Console&);
   private:
     const bool isNrom_128;
 };
@@ -111,7 +149,12 @@ class MMC3Mapper: public Mapper {
     void writePrg(uint16_t p, uint8_t v);
     uint8_t readChr(uint16_t p);
     void writeChr(uint16_t p, uint8_t v);
-    MMC3Mapper(Console&, NESHeader, const std::vector<uint8_t>&);
+    int prgRomOffset(uint16_t p);
+    MMC3Mapper(Console&, NESHeader, std::shared_ptr<const std::vector<uint8_t>>);
+    MMC3Mapper(Console&, MMC3Mapper& other);
+    Mapper *clone(Console&);
+    void save(utils::StateBuffer&);
+    void load(utils::StateBuffer&);
     // this should be called on each rise of PPU A12, and will decrement the
     // counter and/or perform other operations (reloads...) depending on the
     // mapper's internal registers
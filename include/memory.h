@@ -9,6 +9,8 @@
 
 #include "utilities.h"
 #include "logger.h"
+#include "state_buffer.h"
+#include "cow_array.h"
 
 class Console;
 
@@ -27,22 +29,32 @@ class CPUMemory: public Memory {
   public:
     uint8_t read(uint16_t);
     void write(uint16_t, uint8_t);
+    void save(utils::StateBuffer&);
+    void load(utils::StateBuffer&);
     CPUMemory(Console&); 
+    // creates a copy of other for another console, sharing its RAM until one
+    // of them writes to it
+    CPUMemory(Console&, CPUMemory& other);
   private:
     static const int RAM_SIZE = 0x800;
-    uint8_t ram[RAM_SIZE];
+    utils::CowArray ram;
 };
 
 class PPUMemory: public Memory {
   public:
     uint8_t read(uint16_t);
     void write(uint16_t, uint8_t);
+    void save(utils::StateBuffer&);
+    void load(utils::StateBuffer&);
     PPUMemory(Console&); 
+    // creates a copy of other for another console, sharing its name tables
+    // until one of them writes to them
+    PPUMemory(Console&, PPUMemory& other);
   private:
     static const int PALETTE_SIZE = 0x0020;
     static const int NAME_TABLE_SIZE = 0x1000;
     uint8_t palette[PALETTE_SIZE];
-    uint8_t nameTable[NAME_TABLE_SIZE];
+    utils::CowArray nameTable;
 };
 
 #endif
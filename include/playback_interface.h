@@ -0,0 +1,42 @@
+#ifndef GUARD_PLAYBACK_INTERFACE_H
+#define GUARD_PLAYBACK_INTERFACE_H
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "io_interface.h"
+#include "btnstream.h"
+#include "screenstream.h"
+#include "hashstream.h"
+
+// PlaybackInterface is a headless interface, meant to run sessions without a
+// window.
+//
+// It replays the button presses saved in a button log, and saves the output to
+// a screen log, or to a golden file if its name ends with GOLDEN_EXTENSION.
+// Either path can be empty, in which case there is no input (respectively the
+// output is discarded).
+class PlaybackInterface: public IOInterface {
+  public:
+    PlaybackInterface(std::string btnLogPath, std::string scrnLogPath);
+    ~PlaybackInterface();
+    bool shouldClose();
+    bool shouldReset();
+    bool shouldRewind();
+    void render();
+    void colorPixel(int x, int y, int palette);
+    void setRomHash(uint32_t hash);
+    std::array<ButtonSet, 2> getButtons();
+  private:
+    utils::ScreenStream *screenStream;
+    utils::HashStream *hashStream;
+    // screen, when writing a golden file
+    std::vector<uint8_t> frame;
+
+    // the movie, and the frame whose input comes next (see getButtons)
+    utils::Movie movie;
+    long inputFrame;
+};
+
+#endif
@@ -6,6 +6,7 @@
 
 #include "memory.h"
 #include "utilities.h"
+#include "state_buffer.h"
 
 struct SpritePixel {
   int num;
@@ -118,6 +119,7 @@ class PPUDATA: public Register {
     uint8_t read();
     void write(uint8_t);
     PPUDATA(PPU&);
+    friend class PPU;
   private:
     uint8_t bufferedValue;
 };
@@ -140,7 +142,14 @@ class PPU {
     const static int PRE_RENDER_SCAN_LINE = 261;
     const static int POST_RENDER_SCAN_LINE = 240;
     PPU(Console& console);
+    // creates a copy of other for another console
+    PPU(Console& console, PPU& other);
     PPUStateData dumpState();
+    // save appends the PPU state (registers, OAM, palettes and nametables) to
+    // state, and load restores it
+    void save(utils::StateBuffer& state);
+    void load(utils::StateBuffer& state);
+    long getFrameCount();
     uint8_t readRegister(uint16_t);
     void writeRegister(uint16_t, uint8_t);
     void reset();
@@ -161,8 +170,14 @@ class PPU {
     void uploadToOamdata(uint16_t, uint16_t);
     void makeCpuWait(int);
     long getClock();
+    // used to measure sprite evaluation alone: loads the sprites of the line
+    // following line, as done at the end of each visible line
+    void debugLoadSpriteData(int line);
     friend class PPUDATA;
   private:
+    // saveRegisters and loadRegisters handle the whole state but the memory
+    void saveRegisters(utils::StateBuffer& state);
+    void loadRegisters(utils::StateBuffer& state);
     void tick();
     void nmiChange();
     void fetchHigherTileByte();
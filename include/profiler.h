@@ -0,0 +1,124 @@
+#ifndef GUARD_PROFILER_H
+#define GUARD_PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace utils {
+
+// PROFILE_TRACE_FILE is where the trace is written when dumping the profile
+const std::string PROFILE_TRACE_FILE = "asten_profile.json";
+
+// ProfileZone are the parts of the emulator the profiler tells apart
+enum ProfileZone {
+  CPU_ZONE,
+  // PPU work but sprite evaluation: background fetches and pixels are done dot
+  // by dot, too often to be timed on their own
+  PPU_ZONE,
+  PPU_SPRITES_ZONE,
+  RENDER_ZONE,
+  SCREEN_LOG_ZONE,
+  ZONE_COUNT
+};
+
+// readTicks returns a cheap timestamp: the time stamp counter on x86, and
+// nanoseconds elsewhere
+inline uint64_t readTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Profiler accumulates the time spent in each zone, frame by frame. It is
+// meant to be used through PROFILE_SCOPE, from the thread running the
+// emulation only.
+class Profiler {
+  public:
+    static Profiler& get() { return instance; }
+    void add(ProfileZone zone, uint64_t ticks) {
+      current.ticks[zone] += ticks;
+      current.calls[zone]++;
+    }
+    // endFrame closes the current frame and starts the next one
+    void endFrame();
+    // printTable writes the average time spent per frame in each zone
+    void printTable(std::ostream&);
+    // printCurrentFrame writes the time spent in each zone so far in the
+    // current frame
+    void printCurrentFrame(std::ostream&);
+    // writeTrace writes the latest frames as Chrome trace events (to open in
+    // chrome://tracing or Perfetto)
+    void writeTrace(std::string path);
+  private:
+    Profiler();
+    static Profiler instance;
+    // number of frames kept for writeTrace
+    static const size_t TRACE_FRAMES = 3600;
+    struct Frame {
+      uint64_t start, end;
+      uint64_t ticks[ZONE_COUNT];
+      uint64_t calls[ZONE_COUNT];
+    };
+    Frame current;
+    // sums of all the frames
+    Frame total;
+    uint64_t totalFrameTicks;
+    long frameCount;
+    // the latest frames, as a ring of TRACE_FRAMES
+    std::vector<Frame> frames;
+    // used to convert ticks to time
+    uint64_t startTicks;
+    std::chrono::steady_clock::time_point startTime;
+    double ticksPerMicrosecond();
+};
+
+// ProfileScope adds the time spent between its creation and its destruction
+// to a zone. Time spent in nested scopes only counts for the innermost one.
+class ProfileScope {
+  public:
+    explicit ProfileScope(ProfileZone z): zone(z), children(0), parent(innermost) {
+      innermost = this;
+      start = readTicks();
+    }
+    ~ProfileScope() {
+      uint64_t elapsed = readTicks() - start;
+      innermost = parent;
+      if (parent != nullptr)
+        parent->children += elapsed;
+      Profiler::get().add(zone, elapsed - children);
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+  private:
+    ProfileZone zone;
+    uint64_t start;
+    uint64_t children;
+    ProfileScope *parent;
+    static thread_local ProfileScope *innermost;
+};
+
+} // namespace utils
+
+// The profiler is only compiled in with the ASTEN_PROFILER option, and costs
+// nothing otherwise
+#ifdef ASTEN_PROFILER
+#define PROFILE_CAT_(a, b) a##b
+#define PROFILE_CAT(a, b) PROFILE_CAT_(a, b)
+#define PROFILE_SCOPE(zone) utils::ProfileScope PROFILE_CAT(profileScope, __LINE__)(utils::zone)
+#define PROFILE_END_FRAME() utils::Profiler::get().endFrame()
+#else
+#define PROFILE_SCOPE(zone)
+#define PROFILE_END_FRAME()
+#endif
+
+#endif
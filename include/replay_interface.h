@@ -4,26 +4,82 @@
 #include <array>
 #include <fstream>
 #include <string>
+#include <vector>
 
 #include "io_interface.h"
-#include "screenstream.h"
+#include "logger.h"
+#include "screen_prefetcher.h"
 
 // ReplayInterface is a wrapper around another interface
 //
-// It will read from a saved monitor file and display whatever was saved there
+// It will read from a saved monitor file and display whatever was saved there.
+// The emulation only sets the pace: each frame it renders shows the frame of
+// the log that is due, the log being decoded ahead of time by a thread of its
+// own (see utils::ScreenPrefetcher).
+//
+// Playback can be paused, stepped, sped up or slowed down, and seeked to any
+// frame (v2 logs only), from the code or with the controller buttons of the
+// target:
+// - START pauses and resumes
+// - RIGHT and LEFT step one frame forward and backward when paused, and skip
+//   SKIP_FRAMES otherwise
+// - UP and DOWN double and halve the speed
+// - SELECT goes back to the first frame
 class ReplayInterface: public IOInterface {
   public:
+    // speeds allowed by setSpeed
+    static constexpr double MIN_SPEED = 0.25;
+    static constexpr double MAX_SPEED = 16;
+    // SKIP_FRAMES is the number of frames LEFT and RIGHT skip (5 seconds)
+    static const int SKIP_FRAMES = 300;
     ReplayInterface(InterfaceType targetType, std::string btnLogPath, std::string scrnLogPath);
+    ~ReplayInterface();
     bool shouldClose();
     bool shouldReset();
+    bool shouldRewind();
     void render();
     void colorPixel(int x, int y, int palette);
+    void setEmphasis(int emphasis);
+    void setRomHash(uint32_t hash);
     std::array<ButtonSet, 2> getButtons();
+
+    // seek shows frame next
+    void seek(long frame);
+    // setSpeed sets how many frames of the log are shown per frame rendered
+    // (within MIN_SPEED and MAX_SPEED)
+    void setSpeed(double speed);
+    double getSpeed() const { return speed; }
+    void setPaused(bool paused);
+    bool isPaused() const { return paused; }
+    // step moves frames forward (or backward if negative) once paused
+    void step(int frames);
+    // getFrame returns the number of the frame shown
+    long getFrame() const { return frame; }
+    // getFrameCount returns the number of frames of the log (0 for v1 logs,
+    // which can only be played forward)
+    long getFrameCount() const { return screenLog.getFrameCount(); }
   private:
+    Logger log;
     IOInterface *target;
-    utils::ScreenStream screenStream;
+    utils::ScreenPrefetcher screenLog;
+
+    // screen shown, and its number in the log (-1 before the first one)
+    std::vector<uint8_t> screen;
+    long frame;
+    double speed;
+    bool paused;
+    // fraction of a frame to move forward, when slower than one frame per
+    // render
+    double progress;
+    // frames to move forward on the next render, whatever the speed
+    int steps;
+    // whether the end of the log was reached
+    bool atEnd;
+    // buttons of the previous frame, to act on presses only
+    ButtonSet previousButtons;
 
-    bool isClose;
+    void advance(int frames);
+    void handleButtons(ButtonSet buttons);
 };
 
 #endif
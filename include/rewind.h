@@ -0,0 +1,62 @@
+#ifndef GUARD_REWIND_H
+#define GUARD_REWIND_H
+
+#include <cstdint>
+#include <vector>
+
+#include "logger.h"
+#include "state_buffer.h"
+
+class Console;
+// Rewinder keeps a history of the console state so that a session can be played
+// backwards.
+//
+// Every interval frames the whole state is captured, and the difference with
+// the previous capture is stored in a ring of fixed capacity: the two captures
+// are XORed and the result is run length encoded. Consecutive captures only
+// differ by a few hundred bytes, so this is much cheaper than keeping full
+// snapshots. Going back one entry applies a single delta to the latest capture,
+// so the cost of a step does not depend on the length of the history.
+class Rewinder {
+  public:
+    Rewinder(Console&, int interval, int capacity);
+    // record must be called once per emulated frame, and captures the console
+    // state every interval frames
+    void record();
+    // stepBack restores the console to the latest capture, then moves the
+    // history one entry back. It returns false if there is nothing left to go
+    // back to (the console is then restored to the oldest capture)
+    bool stepBack();
+    // memoryUsage returns the number of bytes held by the history
+    long memoryUsage();
+    // bytesPerMinute estimates the number of bytes needed to hold one minute
+    // of history (at 60 frames per second), based on the current history
+    long bytesPerMinute();
+  private:
+    Logger log;
+    Console& console;
+    // number of frames between two captures
+    int interval;
+    int framesSinceCapture;
+    // number of captures done, used to report memory usage regularly
+    long captureCount;
+
+    // latest is the full state of the latest capture, and capture a buffer
+    // used to take new ones
+    utils::StateBuffer latest;
+    utils::StateBuffer capture;
+
+    // ring of encoded deltas, the entry at head being the most recent one
+    std::vector<std::vector<uint8_t>> ring;
+    int head;
+    int count;
+    long ringBytes;
+
+    long capturesPerMinute();
+    // encodeDelta stores the run length encoded XOR of a and b in out
+    static void encodeDelta(const uint8_t* a, const uint8_t* b, size_t size, std::vector<uint8_t>& out);
+    // applyDelta XORs an encoded delta into state
+    static void applyDelta(const std::vector<uint8_t>& delta, uint8_t* state, size_t size);
+};
+
+#endif
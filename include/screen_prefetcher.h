@@ -0,0 +1,75 @@
+#ifndef GUARD_SCREEN_PREFETCHER_H
+#define GUARD_SCREEN_PREFETCHER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "screenstream.h"
+#include "spsc_queue.h"
+
+namespace utils {
+// ScreenPrefetcher reads a screen log on a thread of its own, so that
+// decoding it does not slow the emulation down: the thread stays up to
+// queueFrames frames ahead of the reader, which bounds the memory used
+// whatever the length of the log.
+//
+// Frames are screenSize pixels, as read by ScreenStream::readPixels.
+class ScreenPrefetcher {
+  public:
+    // QUEUE_FRAMES is the default number of frames decoded in advance
+    static const int QUEUE_FRAMES = 8;
+    ScreenPrefetcher(std::string fileName, int screenSize, int queueFrames = QUEUE_FRAMES);
+    ~ScreenPrefetcher();
+    ScreenPrefetcher(const ScreenPrefetcher&) = delete;
+    ScreenPrefetcher& operator=(const ScreenPrefetcher&) = delete;
+    // next waits for the next frame of the log, and returns its pixels, size
+    // being set to their number (less than screenSize for a last frame that
+    // is not complete, and 0 at the end of the log). The pixels are valid
+    // until the following call. It throws if the log could not be decoded.
+    const uint8_t* next(int& size);
+    // seek makes frame the next one returned by next. Frames that were
+    // already decoded are skipped to, and the decoder starts over from the
+    // chunk of frame otherwise (v2 logs only).
+    void seek(long frame);
+    // getPosition returns the number of the frame next returns next
+    long getPosition() const { return position; }
+    // getFrameCount returns the number of complete frames of a v2 log (0 for
+    // a v1 log)
+    long getFrameCount() const { return stream.getFrameCount(); }
+    uint32_t getRomHash() const { return stream.getRomHash(); }
+  private:
+    struct Frame {
+      std::vector<uint8_t> pixels;
+      int size;
+      // set if decoding failed (size is then 0)
+      std::string error;
+    };
+    ScreenStream stream;
+    int screenSize;
+    SpscQueue<Frame> queue;
+    // whether the front of the queue was returned by next, and is to be
+    // popped by the following call
+    bool holding;
+    long position;
+
+    // lock is only used to wait: the reader waits for frames, and the decoder
+    // for free slots. Both also wake up periodically, so that a missed
+    // notification only delays them.
+    std::mutex lock;
+    std::condition_variable frameAvailable;
+    std::condition_variable slotAvailable;
+    std::atomic<bool> stopping;
+    std::thread decoder;
+
+    void start();
+    void stop();
+    void run();
+};
+} // namespace utils
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef GUARD_SCREEN_RECORDER_H
+#define GUARD_SCREEN_RECORDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "screenstream.h"
+#include "spsc_queue.h"
+
+namespace utils {
+// RecorderPolicy is what ScreenRecorder does with a frame when the writer
+// thread is behind and its queue is full
+enum RecorderPolicy {
+  // BLOCK_WHEN_FULL waits for the writer: the log is complete, but the
+  // emulation can stall on a slow disk
+  BLOCK_WHEN_FULL,
+  // DROP_WHEN_FULL drops the frame (and counts it): the emulation never
+  // waits, but the log misses frames
+  DROP_WHEN_FULL,
+};
+
+// ScreenRecorder writes a screen log on a thread of its own, so that
+// compressing and writing it does not slow the emulation down.
+//
+// Pixels are gathered into frames of screenSize pixels, which are handed to
+// the writer thread through a queue of QUEUE_FRAMES frames. The log is the
+// same as the one ScreenStream would write (minus the dropped frames).
+class ScreenRecorder {
+  public:
+    // QUEUE_FRAMES is the number of frames the writer thread can be behind
+    static const int QUEUE_FRAMES = 64;
+    ScreenRecorder(std::string fileName, int screenSize, RecorderPolicy policy = BLOCK_WHEN_FULL);
+    // the destructor closes the log if needed
+    ~ScreenRecorder();
+    ScreenRecorder(const ScreenRecorder&) = delete;
+    ScreenRecorder& operator=(const ScreenRecorder&) = delete;
+    void write(uint8_t palette) {
+      *cursor++ = palette;
+      if (cursor == frameEnd)
+        pushFrame();
+    }
+    // setRomHash sets the hash written to the header on close
+    void setRomHash(uint32_t hash) { stream.setRomHash(hash); }
+    // close writes the frames left (including the one being filled), waits
+    // for the writer thread and closes the log. It can be called several
+    // times.
+    void close();
+    long getDroppedFrames() const { return droppedFrames; }
+  private:
+    struct Frame {
+      std::vector<uint8_t> pixels;
+      // number of pixels of the frame (less than screenSize for the last one)
+      int size;
+    };
+    ScreenStream stream;
+    int screenSize;
+    RecorderPolicy policy;
+    SpscQueue<Frame> queue;
+    // current is the frame being filled: a slot of the queue, or spare when
+    // the queue is full and the frame is going to be dropped
+    Frame *current;
+    Frame spare;
+    // cursor is the next pixel of the current frame, and frameEnd its end
+    // (pointers are cheaper to update per pixel than an index into current)
+    uint8_t *cursor;
+    uint8_t *frameEnd;
+    long droppedFrames;
+    bool closed;
+
+    // lock is only used to wait: the writer waits for frames, and a blocked
+    // emulation for free slots. Both also wake up periodically, so that a
+    // missed notification only delays them.
+    std::mutex lock;
+    std::condition_variable frameAvailable;
+    std::condition_variable slotAvailable;
+    std::atomic<bool> stopping;
+    std::thread writer;
+
+    // pushFrame hands the current frame to the writer and takes the next slot
+    void pushFrame();
+    void nextFrame();
+    void run();
+};
+} // namespace utils
+
+#endif
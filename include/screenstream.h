@@ -7,32 +7,152 @@
 
 #include "streams.h"
 #include "byte_aggregator.h"
+#include "mapped_file.h"
 
 namespace utils {
 // SCREENSTREAM_END is the value found at the end of files produced by
 // ScreenStream (an EOF of sorts)
 const uint8_t SCREENSTREAM_END = 255;
 
+// ScreenFormat are the formats of the files written by ScreenStream. Reading
+// detects the format of the file.
+enum ScreenFormat {
+  // SCREEN_V1 is a run-length encoding of every pixel (see ByteAggregator)
+  SCREEN_V1,
+  // SCREEN_V2 is made of chunks of frames that can be decoded independently,
+  // and has an index of the chunks to seek to any frame
+  SCREEN_V2,
+};
+
 // ScreenStream is a wrapper around a bit stream that writes palette palette
 // values to a file, compressing them in the process. Conversly, it can also
 // decompress it to return the values in the same order.
+//
+// A v2 file is made of:
+// - a header: "SCR", the version (2), then the screen size, the number of
+//   frames per chunk and the hash of the ROM (see Mapper::romHash), all on 4
+//   bytes
+// - the chunks, each made of one record per frame, starting with its type:
+//   - KEYFRAME (first frame of a chunk): the runs of the frame
+//   - DELTA: a bitmap of the rows that changed since the previous frame (one
+//     bit per row, lowest bit first), then the runs of each of these rows,
+//     KEEP meaning that the pixels did not change
+//   - REPEAT: the frame is the same as the previous one
+//   - PARTIAL: the number of pixels, and their runs (for a last frame that is
+//     not complete)
+//   Runs are a varint (7 bits per byte, lowest first) count and the value.
+// - SCREENSTREAM_END
+// - the index: the offset of each chunk in the file, on 8 bytes
+// - a trailer (see Trailer)
+// Integers are little endian.
 class ScreenStream {
   public:
+    // ROW_SIZE is the number of pixels of a row (the unit of v2 deltas). For
+    // v2, screenSize must be a multiple of it.
+    static const int ROW_SIZE = 256;
+    // CHUNK_FRAMES is the number of frames of the chunks written
+    static const int CHUNK_FRAMES = 300;
     // XXX: screenSize is supposed to be a multiple of 8
-    ScreenStream(std::string fileName, StreamMode mode, int screenSize);
+    ScreenStream(std::string fileName, StreamMode mode, int screenSize, ScreenFormat format = SCREEN_V2);
+    ~ScreenStream();
+    ScreenStream(const ScreenStream&) = delete;
+    ScreenStream& operator=(const ScreenStream&) = delete;
     // write palette to the file, assuming palette is < 64
     void write(uint8_t palette);
+    // writeFrame writes screenSize pixels at once
+    void writeFrame(const uint8_t *pixels);
     // read the palette value. The nth call to read() is guaranteed to return
     // the same value that was written with the nth call to write().
-    uint8_t read();
+    uint8_t read() {
+      if (position < available)
+        return frame[position++];
+      return decodeFrame() ? frame[position++] : SCREENSTREAM_END;
+    }
+    // readFrame reads screenSize pixels at once, and returns false if the
+    // stream ended before
+    bool readFrame(uint8_t *pixels) { return readPixels(pixels) == screenSize; }
+    // readPixels reads up to screenSize pixels, and returns how many it read
+    // (less than screenSize only at the end of the stream)
+    int readPixels(uint8_t *pixels);
+    // seek moves a v2 stream to the beginning of frame (which can be the
+    // frame count, to go to the end)
+    void seek(long frame);
+    ScreenFormat getFormat() const { return format; }
+    // getFrameCount returns the number of complete frames of a v2 stream
+    long getFrameCount() const { return frameCount; }
+    int getChunkCount() const { return chunkOffsets.size(); }
+    int getChunkFrames() const { return chunkFrames; }
+    // readChunk returns the encoded frames of a chunk of a v2 stream, to be
+    // decoded with decodeChunk (possibly on another thread)
+    std::vector<uint8_t> readChunk(int chunk);
+    // decodeChunk decodes the frames of a chunk one after the other, and
+    // returns the number of pixels
+    static long decodeChunk(const std::vector<uint8_t>& chunk, int screenSize, std::vector<uint8_t>& pixels);
+    // the ROM hash is written on close, and is 0 if it was never set
+    void setRomHash(uint32_t hash) { romHash = hash; }
+    uint32_t getRomHash() const { return romHash; }
     // close the underlying stream. As output is bufferized, this must be called
     // in order to avoid missing data
     void close();
   private:
+    // types of v2 records
+    static const uint8_t KEYFRAME = 1;
+    static const uint8_t DELTA = 2;
+    static const uint8_t REPEAT = 3;
+    static const uint8_t PARTIAL = 4;
+    // run value of unchanged pixels in deltas
+    static const uint8_t KEEP = 0x40;
+    static const char SIGNATURE[3];
+    static const char TRAILER_SIGNATURE[4];
+    static const int ROM_HASH_OFFSET = 12;
+    struct Trailer {
+      uint64_t indexOffset;
+      uint64_t frameCount;
+      uint32_t chunkCount;
+      char signature[4];
+    };
+    // streams are written through stream, and read from file
     std::fstream stream;
+    MappedFile *file;
+    std::string fileName;
+    ScreenFormat format;
+    int screenSize;
+    int chunkFrames;
+    uint32_t romHash;
 
+    // v1
     AggrBytes currentColor;
     ByteAggregator colorAggregator;
+    void writeV1(uint8_t palette);
+    bool decodeFrameV1();
+
+    // frame is the frame being written (or read), and previous the last one
+    // written (v2 only)
+    std::vector<uint8_t> frame;
+    std::vector<uint8_t> previous;
+    // position is the next pixel of frame to write (or read), out of
+    // available pixels when reading
+    int position;
+    int available;
+    long frameCount;
+    std::vector<uint64_t> chunkOffsets;
+    uint64_t indexOffset;
+    // encoded record, written at once
+    std::string record;
+    void encodeFrame(int size);
+    void appendRuns(const uint8_t *pixels, const uint8_t *reference, int size);
+    void writeIndex();
+    // cursor is the next byte to read, and chunkEnd the end of the chunk it
+    // is in (of the file for v1)
+    const uint8_t *cursor;
+    const uint8_t *chunkEnd;
+    int nextChunk;
+    void readIndex();
+    void findChunk(int index, const uint8_t *&begin, const uint8_t *&end);
+    // decodeFrame decodes the next frame (or what is left of it) to frame,
+    // and returns false at the end of the stream
+    bool decodeFrame();
+    static int decodeRecord(const uint8_t *&data, const uint8_t *end, uint8_t *pixels, int screenSize);
 };
 } // namespace utils
 
@@ -33,6 +33,8 @@ class ShaderProgram {
     void setInt(const std::string&, int) const;
     void setBool(const std::string&, bool) const;
     void setFloat(const std::string&, float) const;
+    // setVec3Array sets an array of count vec3 from 3 * count floats
+    void setVec3Array(const std::string&, const float*, int count) const;
     // getter
     unsigned int getID();
   private:
@@ -0,0 +1,55 @@
+#ifndef GUARD_SPSC_QUEUE_H
+#define GUARD_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace utils {
+// SpscQueue is a bounded queue handing values over from one producer thread
+// to one consumer thread without locks.
+//
+// Its slots are allocated once: the producer fills the slot returned by
+// back() and pushes it, and the consumer reads front() and pops it, so large
+// values (such as frames) are never copied nor allocated on the way. Indexes
+// only grow and are wrapped when accessing slots.
+template<class T>
+class SpscQueue {
+  public:
+    // SpscQueue holds up to capacity values, its slots being copies of
+    // prototype
+    SpscQueue(size_t capacity, const T& prototype = T()):
+      slots(capacity, prototype), head(0), tail(0) {}
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+    // back returns the slot to fill before calling push, or NULL if the queue
+    // is full (producer thread only)
+    T* back() {
+      size_t t = tail.load(std::memory_order_relaxed);
+      if (t - head.load(std::memory_order_acquire) == slots.size())
+        return NULL;
+      return &slots[t % slots.size()];
+    }
+    void push() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    // front returns the oldest pushed value, or NULL if the queue is empty
+    // (consumer thread only)
+    T* front() {
+      size_t h = head.load(std::memory_order_relaxed);
+      if (h == tail.load(std::memory_order_acquire))
+        return NULL;
+      return &slots[h % slots.size()];
+    }
+    void pop() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    // size returns the number of values pushed and not popped yet (consumer
+    // thread only, as more can be pushed meanwhile)
+    size_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_relaxed); }
+    size_t capacity() const { return slots.size(); }
+  private:
+    std::vector<T> slots;
+    // head is the next slot to read, and tail the next one to write
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+};
+} // namespace utils
+
+#endif
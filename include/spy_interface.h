@@ -6,36 +6,41 @@
 #include <fstream>
 
 #include "io_interface.h"
+#include "logger.h"
 #include "btnstream.h"
-#include "screenstream.h"
+#include "screen_recorder.h"
 
 // SpyInterface is a wrapper around another IOInterface.
 //
-// It will mimic its properties all the while sending usage statistics
+// It will mimic its properties all the while sending usage statistics. The
+// screen log is written by a thread of its own (see utils::ScreenRecorder),
+// policy telling what to do when it falls behind.
 class SpyInterface: public IOInterface {
   public:
-    SpyInterface(InterfaceType targetType, std::string btnLogPath, std::string scrnLogPath);
+    SpyInterface(
+      InterfaceType targetType,
+      std::string btnLogPath,
+      std::string scrnLogPath,
+      utils::RecorderPolicy policy = utils::BLOCK_WHEN_FULL
+    );
+    ~SpyInterface();
     bool shouldClose();
     bool shouldReset();
+    bool shouldRewind();
     void render();
     void colorPixel(int x, int y, int palette);
+    void setEmphasis(int emphasis);
+    void setRomHash(uint32_t hash);
     std::array<ButtonSet, 2> getButtons();
   private:
     static const int BUF_SIZE = 1048576; // 1 MB
+    Logger log;
     IOInterface *target;
 
-    utils::ScreenStream screenStream;
+    utils::ScreenRecorder screenRecorder;
     utils::BtnStream btnStream;
-    
-    void writeCurrentButtons();
-    void writeCurrentReset();
 
-    // identicalCount indicates the number of times getButtons() has been called
-    // before there was a change in currentButtons;
-    long identicalCount;
-    std::array<ButtonSet, 2> currentButtons;
-
-    long identicalRstCount;
+    // reset of the current frame, recorded along with the buttons
     bool currentReset;
 };
 
@@ -0,0 +1,40 @@
+#ifndef GUARD_STATE_BUFFER_H
+#define GUARD_STATE_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace utils {
+// StateBuffer is a flat, byte oriented image of the state of the machine.
+//
+// Each component appends its fields with write() in its save() function, and
+// reads them back in the same order with read() in its load() function. The
+// buffer is reusable: clear() keeps the underlying allocation, so taking a
+// snapshot every frame does not allocate.
+class StateBuffer {
+  public:
+    StateBuffer();
+    // write appends the raw representation of value (which has to be a plain
+    // value or an array of plain values)
+    template<class T>
+    void write(const T& value) { write(&value, sizeof(T)); }
+    void write(const void* bytes, size_t size);
+    // read fills value with the next sizeof(T) bytes of the buffer
+    template<class T>
+    void read(T& value) { read(&value, sizeof(T)); }
+    void read(void* bytes, size_t size);
+    // seekStart moves the read cursor back to the beginning of the buffer
+    void seekStart();
+    // clear empties the buffer
+    void clear();
+    size_t size() const;
+    uint8_t* data();
+    const uint8_t* data() const;
+  private:
+    std::vector<uint8_t> bytes;
+    size_t cursor;
+};
+} // namespace utils
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef GUARD_THREAD_POOL_H
+#define GUARD_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+// ThreadPool runs tasks on a fixed number of worker threads.
+//
+// Each worker has its own queue of tasks. submit() hands tasks to the workers
+// in turn, and a worker that runs out of work steals from the front of the
+// queue of another one, so that a few long tasks do not leave the other
+// workers idle.
+class ThreadPool {
+  public:
+    typedef std::function<void()> Task;
+    // ThreadPool starts size workers (or one per hardware thread if size is 0)
+    ThreadPool(int size = 0);
+    // the destructor waits for all the submitted tasks to be done
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    // submit queues task to be run by one of the workers. Tasks should not
+    // throw.
+    void submit(Task task);
+    // wait blocks until all the submitted tasks are done
+    void wait();
+    int size();
+  private:
+    struct Worker {
+      std::mutex lock;
+      std::deque<Task> tasks;
+    };
+    std::vector<Worker*> workers;
+    std::vector<std::thread> threads;
+
+    // lock protects pending, queued and stopping, and is used to wake up idle
+    // workers and threads waiting for completion
+    std::mutex lock;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    // number of tasks submitted but not done yet
+    long pending;
+    // number of tasks waiting in a queue, or about to be (idle workers that
+    // find nothing then simply look again)
+    long queued;
+    bool stopping;
+    // index of the worker that gets the next submitted task
+    std::atomic<unsigned> nextWorker;
+
+    void run(int index);
+    bool popTask(int index, Task& task);
+};
+} // namespace utils
+
+#endif
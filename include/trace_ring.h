@@ -0,0 +1,59 @@
+#ifndef GUARD_TRACE_RING_H
+#define GUARD_TRACE_RING_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace utils {
+// TraceRecord is the state of the console before one CPU instruction
+struct TraceRecord {
+  // number of CPU cycles since power on
+  uint64_t cycle;
+  uint16_t pc;
+  uint16_t scanLine, dot;
+  // opcode and operands (only the first instructionSize - 1 are meaningful)
+  uint8_t opcode, operands[2];
+  uint8_t A, X, Y, P, sp;
+};
+
+// TraceRing writes records to a file mapped in memory, that holds the latest
+// capacity records: writing one is as cheap as a copy, so tracing can be left
+// on at full speed. The file is up to date even if the program crashes.
+//
+// The file is a header (see Header) followed by the capacity records.
+class TraceRing {
+  public:
+    TraceRing(std::string fileName, size_t capacity);
+    ~TraceRing();
+    TraceRing(const TraceRing&) = delete;
+    TraceRing& operator=(const TraceRing&) = delete;
+    void write(const TraceRecord& record) {
+      records[next] = record;
+      next = next + 1 == capacity ? 0 : next + 1;
+      header->written++;
+    }
+    // readAll returns the records of a file written by a TraceRing, oldest
+    // first
+    static std::vector<TraceRecord> readAll(std::string fileName);
+  private:
+    struct Header {
+      char magic[8];
+      uint32_t version;
+      uint32_t recordSize;
+      uint64_t capacity;
+      // total number of records written, including the overwritten ones
+      uint64_t written;
+    };
+    static const char MAGIC[8];
+    static const uint32_t VERSION = 1;
+    size_t capacity;
+    size_t next;
+    size_t mappedSize;
+    void *mapped;
+    Header *header;
+    TraceRecord *records;
+};
+} // namespace utils
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef GUARD_TRIPLE_BUFFER_H
+#define GUARD_TRIPLE_BUFFER_H
+
+#include <atomic>
+
+namespace utils {
+// TripleBuffer hands values over from one writer thread to one reader thread
+// without locks, and without either ever waiting for the other: the writer
+// fills a back buffer and publishes it, and the reader always gets the latest
+// published value (intermediate ones are dropped).
+//
+// Of the three buffers, one is owned by the writer, one by the reader, and the
+// last one (the latest published) is exchanged between them.
+template<class T>
+class TripleBuffer {
+  public:
+    TripleBuffer(): buffers(), back(0), front(1), middle(2) {}
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+    // writeBuffer returns the buffer to fill before calling publish (writer
+    // thread only)
+    T& writeBuffer() { return buffers[back]; }
+    void publish() {
+      back = middle.exchange(back | FRESH) & INDEX;
+    }
+    // update makes the latest published value readable through readBuffer,
+    // and returns false if nothing was published since the last call (reader
+    // thread only)
+    bool update() {
+      if ((middle.load() & FRESH) == 0)
+        return false;
+      front = middle.exchange(front) & INDEX;
+      return true;
+    }
+    const T& readBuffer() const { return buffers[front]; }
+  private:
+    // middle holds the index of the exchanged buffer, and whether it was
+    // published since the reader last took it
+    static const int INDEX = 3;
+    static const int FRESH = 4;
+    T buffers[3];
+    int back;
+    int front;
+    std::atomic<int> middle;
+};
+} // namespace utils
+
+#endif
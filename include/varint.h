@@ -0,0 +1,34 @@
+#ifndef GUARD_VARINT_H
+#define GUARD_VARINT_H
+
+#include <cstdint>
+
+namespace utils {
+// Varints store an unsigned integer on as few bytes as it needs: 7 bits per
+// byte, lowest first, the msb of a byte being set if another one follows.
+
+// appendVarint appends value to out (a std::string or a std::vector<uint8_t>)
+template<class Bytes>
+void appendVarint(Bytes& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out.push_back(value);
+}
+
+// readVarint reads the varint at data into value, and moves data past it. It
+// returns false if the varint goes past end or does not fit on 64 bits.
+inline bool readVarint(const uint8_t *&data, const uint8_t *end, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && data < end; shift += 7) {
+    uint8_t byte = *data++;
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+} // namespace utils
+
+#endif
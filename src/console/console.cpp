@@ -1,6 +1,7 @@
 #include "console.h"
 
 #include "mapper.h"
+#include "profiler.h"
 
 
 Mapper *Console::getMapper() { return mapper; }
@@ -19,24 +20,192 @@ Console::Console(std::string romPath, InterfaceType type, std::string btnLogPath
   log(Logger::getLogger("Console")),
   cpu(*this), ppu(*this),
   mapper(Mapper::fromNesFile(*this, romPath)),
-  interface(IOInterface::newIOInterface(type, btnLogPath, scrnLogPath))
+  interface(IOInterface::newIOInterface(type, btnLogPath, scrnLogPath)),
+  rewinder(NULL),
+  guestProfiler(NULL),
+  trace(NULL),
+  runAheadFrames(0), speculativeFramesLeft(0),
+  outputMuted(false), restorePending(false),
+  runAheadTime(0), runAheadCount(0),
+  inputPending(true), resetHeld(false)
 {
   log.setLevel(DEBUG);
+  interface->setRomHash(mapper->romHash());
   cpu.reset();
   ppu.reset();
 }
 
-void Console::step() {
-  if (interface->shouldReset()) {
-    cpu.reset();
+Console::Console(Console& source, IOInterface *i):
+  log(source.log),
+  cpu(*this, source.cpu), ppu(*this, source.ppu),
+  leftController(source.leftController),
+  rightController(source.rightController),
+  mapper(source.mapper->clone(*this)),
+  interface(i != NULL ? i : new IOSink()),
+  rewinder(NULL),
+  guestProfiler(NULL),
+  trace(NULL),
+  runAheadFrames(0), speculativeFramesLeft(0),
+  outputMuted(false), restorePending(false),
+  runAheadTime(0), runAheadCount(0),
+  inputPending(true), resetHeld(false)
+{
+  interface->setRomHash(mapper->romHash());
+}
+
+Console *Console::clone(IOInterface *i) {
+  return new Console(*this, i);
+}
+
+Console::~Console() {
+  delete trace;
+  delete guestProfiler;
+  delete rewinder;
+  delete interface;
+  delete mapper;
+}
+
+long Console::step() {
+  // speculative frames keep the input of the frame they follow, and must not
+  // consume anything from the interface
+  if (speculativeFramesLeft == 0) {
+    if (inputPending)
+      sampleInput();
+    if (resetHeld)
+      cpu.reset();
+  }
+  long cpuSteps = cpu.step();
+  cpu.fastForwardClock(2 * cpuSteps);
+  long frame = ppu.getFrameCount();
+  {
+    // the PPU is timed as a whole here rather than in PPU::step, that is
+    // called too often
+    PROFILE_SCOPE(PPU_ZONE);
+    for (int i = 0; i < 3 * cpuSteps; i++)
+      ppu.step();
   }
+  if (ppu.getFrameCount() != frame)
+    onFrame();
+  return cpuSteps;
+}
+
+// sampleInput hands the buttons over to the controllers, which only show them
+// to the game when it strobes them
+void Console::sampleInput() {
+  inputPending = false;
+  resetHeld = interface->shouldReset();
   auto buttons = interface->getButtons();
   leftController.set(buttons[0]);
   rightController.set(buttons[1]);
-  long cpuSteps = cpu.step();
-  cpu.fastForwardClock(2 * cpuSteps);
-  for (int i = 0; i < 3 * cpuSteps; i++)
-    ppu.step();
+}
+
+bool Console::isOutputMuted() { return outputMuted; }
+
+// endFrame only decides whether the next frame is shown: saving and restoring
+// the state has to wait for the end of the current step (see onFrame), as the
+// PPU is still catching up with the CPU at this point.
+void Console::endFrame() {
+  if (speculativeFramesLeft > 0) {
+    speculativeFramesLeft--;
+    if (speculativeFramesLeft == 0) {
+      // the frame that was just shown was the last speculative one, go back
+      // to the real timeline, where frames are never shown
+      restorePending = true;
+      outputMuted = true;
+    } else {
+      outputMuted = speculativeFramesLeft > 1;
+    }
+    return;
+  }
+
+  if (runAheadFrames > 0) {
+    speculativeFramesLeft = runAheadFrames;
+    outputMuted = speculativeFramesLeft > 1;
+  }
+}
+
+void Console::onFrame() {
+  inputPending = true;
+  if (restorePending) {
+    restorePending = false;
+    runAheadState.seekStart();
+    load(runAheadState);
+    runAheadTime += std::chrono::high_resolution_clock::now() - runAheadStart;
+    runAheadCount++;
+    if (runAheadCount == 60) {
+      auto perFrame = std::chrono::duration_cast<std::chrono::microseconds>(runAheadTime)
+        / (runAheadCount * runAheadFrames);
+      LOG_DEBUG(log) << LOG_LITERAL("run-ahead: ") << perFrame.count()
+                     << LOG_LITERAL("us per speculative frame\n");
+      runAheadTime = std::chrono::nanoseconds(0);
+      runAheadCount = 0;
+    }
+    return;
+  }
+  if (speculativeFramesLeft != runAheadFrames) {
+    // still in the middle of the speculative frames
+    return;
+  }
+
+  if (rewinder != NULL) {
+    if (interface->shouldRewind()) {
+      rewinder->stepBack();
+    } else {
+      rewinder->record();
+    }
+  }
+  if (runAheadFrames > 0) {
+    runAheadStart = std::chrono::high_resolution_clock::now();
+    runAheadState.clear();
+    save(runAheadState);
+  }
+}
+
+void Console::save(utils::StateBuffer& state) {
+  cpu.save(state);
+  ppu.save(state);
+  leftController.save(state);
+  rightController.save(state);
+  mapper->save(state);
+}
+
+void Console::load(utils::StateBuffer& state) {
+  cpu.load(state);
+  ppu.load(state);
+  leftController.load(state);
+  rightController.load(state);
+  mapper->load(state);
+}
+
+void Console::setRunAhead(int frames) {
+  runAheadFrames = frames;
+  speculativeFramesLeft = 0;
+  outputMuted = false;
+  restorePending = false;
+}
+
+void Console::enableRewind(int interval, int capacity) {
+  delete rewinder;
+  rewinder = new Rewinder(*this, interval, capacity);
+}
+
+void Console::enableTrace(std::string fileName, size_t capacity) {
+  cpu.setTrace(NULL);
+  delete trace;
+  trace = NULL;
+  trace = new utils::TraceRing(fileName, capacity);
+  cpu.setTrace(trace);
+}
+
+GuestProfiler *Console::enableGuestProfiler() {
+#ifndef ASTEN_GUEST_PROFILER
+  throw std::runtime_error("the guest profiler requires building with ASTEN_GUEST_PROFILER");
+#endif
+  if (guestProfiler == NULL) {
+    guestProfiler = new GuestProfiler(*this);
+    cpu.setGuestProfiler(guestProfiler);
+  }
+  return guestProfiler;
 }
 
 bool Console::isRunning() {
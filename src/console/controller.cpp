@@ -1,8 +1,11 @@
 #include "controller.h"
 
+#include <algorithm>
+
 Controller::Controller(): 
   log(Logger::getLogger("Controller")),
-  buttons{0}
+  buttons{0},
+  snapshot{0}
 {
   log.setLevel(DEBUG);
   strobe = 0;
@@ -23,17 +26,36 @@ uint8_t Controller::read() {
   return value; 
 }
 
+// While the strobe is set, the controller keeps latching the buttons
 void Controller::write(uint8_t value) {
   strobe = value & 1;
+  if (strobe == 1)
+    std::copy(snapshot, snapshot + 8, buttons);
 }
 
 void Controller::set(ButtonSet bs) {
-  buttons[Buttons::A] = bs.A;
-  buttons[Buttons::B] = bs.B;
-  buttons[Buttons::SELECT] = bs.SELECT;
-  buttons[Buttons::START] = bs.START;
-  buttons[Buttons::UP] = bs.UP;
-  buttons[Buttons::DOWN] = bs.DOWN;
-  buttons[Buttons::LEFT] = bs.LEFT;
-  buttons[Buttons::RIGHT] = bs.RIGHT;
+  snapshot[Buttons::A] = bs.A;
+  snapshot[Buttons::B] = bs.B;
+  snapshot[Buttons::SELECT] = bs.SELECT;
+  snapshot[Buttons::START] = bs.START;
+  snapshot[Buttons::UP] = bs.UP;
+  snapshot[Buttons::DOWN] = bs.DOWN;
+  snapshot[Buttons::LEFT] = bs.LEFT;
+  snapshot[Buttons::RIGHT] = bs.RIGHT;
+  if (strobe == 1)
+    std::copy(snapshot, snapshot + 8, buttons);
+}
+
+void Controller::save(utils::StateBuffer& state) {
+  state.write(buttons);
+  state.write(snapshot);
+  state.write(index);
+  state.write(strobe);
+}
+
+void Controller::load(utils::StateBuffer& state) {
+  state.read(buttons);
+  state.read(snapshot);
+  state.read(index);
+  state.read(strobe);
 }
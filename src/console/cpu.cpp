@@ -1,9 +1,54 @@
 #include "cpu.h"
 
+#include <cstdio>
+
+#include "console.h"
+#include "instrumentation.h"
+#include "profiler.h"
+
 
 constexpr uint8_t CPU::instructionModes[];
 constexpr uint8_t CPU::instructionCycles[];
 constexpr uint8_t CPU::instructionCyclesExtra[];
+constexpr uint8_t CPU::instructionSizes[];
+constexpr bool CPU::instructionOfficial[];
+
+// the instruction table is shared by all the CPUs, so that creating one (when
+// cloning a console, for instance) does not have to fill it
+const CPU::cpuInstruction CPU::instructionTable[256] = {
+  &CPU::brk, &CPU::ora, &CPU::kil, &CPU::slo, &CPU::nop, &CPU::ora, &CPU::asl, &CPU::slo,
+  &CPU::php, &CPU::ora, &CPU::asl, &CPU::anc, &CPU::nop, &CPU::ora, &CPU::asl, &CPU::slo,
+  &CPU::bpl, &CPU::ora, &CPU::kil, &CPU::slo, &CPU::nop, &CPU::ora, &CPU::asl, &CPU::slo,
+  &CPU::clc, &CPU::ora, &CPU::nop, &CPU::slo, &CPU::nop, &CPU::ora, &CPU::asl, &CPU::slo,
+  &CPU::jsr, &CPU::_and, &CPU::kil, &CPU::rla, &CPU::bit, &CPU::_and, &CPU::rol, &CPU::rla,
+  &CPU::plp, &CPU::_and, &CPU::rol, &CPU::anc, &CPU::bit, &CPU::_and, &CPU::rol, &CPU::rla,
+  &CPU::bmi, &CPU::_and, &CPU::kil, &CPU::rla, &CPU::nop, &CPU::_and, &CPU::rol, &CPU::rla,
+  &CPU::sec, &CPU::_and, &CPU::nop, &CPU::rla, &CPU::nop, &CPU::_and, &CPU::rol, &CPU::rla,
+  &CPU::rti, &CPU::eor, &CPU::kil, &CPU::sre, &CPU::nop, &CPU::eor, &CPU::lsr, &CPU::sre,
+  &CPU::pha, &CPU::eor, &CPU::lsr, &CPU::alr, &CPU::jmp, &CPU::eor, &CPU::lsr, &CPU::sre,
+  &CPU::bvc, &CPU::eor, &CPU::kil, &CPU::sre, &CPU::nop, &CPU::eor, &CPU::lsr, &CPU::sre,
+  &CPU::cli, &CPU::eor, &CPU::nop, &CPU::sre, &CPU::nop, &CPU::eor, &CPU::lsr, &CPU::sre,
+  &CPU::rts, &CPU::adc, &CPU::kil, &CPU::rra, &CPU::nop, &CPU::adc, &CPU::ror, &CPU::rra,
+  &CPU::pla, &CPU::adc, &CPU::ror, &CPU::arr, &CPU::jmp, &CPU::adc, &CPU::ror, &CPU::rra,
+  &CPU::bvs, &CPU::adc, &CPU::kil, &CPU::rra, &CPU::nop, &CPU::adc, &CPU::ror, &CPU::rra,
+  &CPU::sei, &CPU::adc, &CPU::nop, &CPU::rra, &CPU::nop, &CPU::adc, &CPU::ror, &CPU::rra,
+  &CPU::nop, &CPU::sta, &CPU::nop, &CPU::sax, &CPU::sty, &CPU::sta, &CPU::stx, &CPU::sax,
+  &CPU::dey, &CPU::nop, &CPU::txa, &CPU::xaa, &CPU::sty, &CPU::sta, &CPU::stx, &CPU::sax,
+  &CPU::bcc, &CPU::sta, &CPU::kil, &CPU::ahx, &CPU::sty, &CPU::sta, &CPU::stx, &CPU::sax,
+  &CPU::tya, &CPU::sta, &CPU::txs, &CPU::tas, &CPU::shy, &CPU::sta, &CPU::shx, &CPU::ahx,
+  &CPU::ldy, &CPU::lda, &CPU::ldx, &CPU::lax, &CPU::ldy, &CPU::lda, &CPU::ldx, &CPU::lax,
+  &CPU::tay, &CPU::lda, &CPU::tax, &CPU::lax, &CPU::ldy, &CPU::lda, &CPU::ldx, &CPU::lax,
+  &CPU::bcs, &CPU::lda, &CPU::kil, &CPU::lax, &CPU::ldy, &CPU::lda, &CPU::ldx, &CPU::lax,
+  &CPU::clv, &CPU::lda, &CPU::tsx, &CPU::las, &CPU::ldy, &CPU::lda, &CPU::ldx, &CPU::lax,
+  &CPU::cpy, &CPU::cmp, &CPU::nop, &CPU::dcp, &CPU::cpy, &CPU::cmp, &CPU::dec, &CPU::dcp,
+  &CPU::iny, &CPU::cmp, &CPU::dex, &CPU::axs, &CPU::cpy, &CPU::cmp, &CPU::dec, &CPU::dcp,
+  &CPU::bne, &CPU::cmp, &CPU::kil, &CPU::dcp, &CPU::nop, &CPU::cmp, &CPU::dec, &CPU::dcp,
+  &CPU::cld, &CPU::cmp, &CPU::nop, &CPU::dcp, &CPU::nop, &CPU::cmp, &CPU::dec, &CPU::dcp,
+  &CPU::cpx, &CPU::sbc, &CPU::nop, &CPU::isb, &CPU::cpx, &CPU::sbc, &CPU::inc, &CPU::isb,
+  &CPU::inx, &CPU::sbc, &CPU::nop, &CPU::sbc, &CPU::cpx, &CPU::sbc, &CPU::inc, &CPU::isb,
+  &CPU::beq, &CPU::sbc, &CPU::kil, &CPU::isb, &CPU::nop, &CPU::sbc, &CPU::inc, &CPU::isb,
+  &CPU::sed, &CPU::sbc, &CPU::nop, &CPU::isb, &CPU::nop, &CPU::sbc, &CPU::inc, &CPU::isb,
+};
 
 std::runtime_error notImplementedOp(std::string opcode) {
   return std::runtime_error("Not implemented op: " + opcode);
@@ -17,41 +62,8 @@ bool pagesDiffer(uint16_t a, uint16_t b) {
 
 CPU::CPU(Console& console):
   log(Logger::getLogger("CPU", "cpu.log")),
-  mem(console), 
-  instructionTable{
-    &CPU::brk, &CPU::ora, &CPU::kil, &CPU::slo, &CPU::nop, &CPU::ora, &CPU::asl, &CPU::slo,
-    &CPU::php, &CPU::ora, &CPU::asl, &CPU::anc, &CPU::nop, &CPU::ora, &CPU::asl, &CPU::slo,
-    &CPU::bpl, &CPU::ora, &CPU::kil, &CPU::slo, &CPU::nop, &CPU::ora, &CPU::asl, &CPU::slo,
-    &CPU::clc, &CPU::ora, &CPU::nop, &CPU::slo, &CPU::nop, &CPU::ora, &CPU::asl, &CPU::slo,
-    &CPU::jsr, &CPU::_and, &CPU::kil, &CPU::rla, &CPU::bit, &CPU::_and, &CPU::rol, &CPU::rla,
-    &CPU::plp, &CPU::_and, &CPU::rol, &CPU::anc, &CPU::bit, &CPU::_and, &CPU::rol, &CPU::rla,
-    &CPU::bmi, &CPU::_and, &CPU::kil, &CPU::rla, &CPU::nop, &CPU::_and, &CPU::rol, &CPU::rla,
-    &CPU::sec, &CPU::_and, &CPU::nop, &CPU::rla, &CPU::nop, &CPU::_and, &CPU::rol, &CPU::rla,
-    &CPU::rti, &CPU::eor, &CPU::kil, &CPU::sre, &CPU::nop, &CPU::eor, &CPU::lsr, &CPU::sre,
-    &CPU::pha, &CPU::eor, &CPU::lsr, &CPU::alr, &CPU::jmp, &CPU::eor, &CPU::lsr, &CPU::sre,
-    &CPU::bvc, &CPU::eor, &CPU::kil, &CPU::sre, &CPU::nop, &CPU::eor, &CPU::lsr, &CPU::sre,
-    &CPU::cli, &CPU::eor, &CPU::nop, &CPU::sre, &CPU::nop, &CPU::eor, &CPU::lsr, &CPU::sre,
-    &CPU::rts, &CPU::adc, &CPU::kil, &CPU::rra, &CPU::nop, &CPU::adc, &CPU::ror, &CPU::rra,
-    &CPU::pla, &CPU::adc, &CPU::ror, &CPU::arr, &CPU::jmp, &CPU::adc, &CPU::ror, &CPU::rra,
-    &CPU::bvs, &CPU::adc, &CPU::kil, &CPU::rra, &CPU::nop, &CPU::adc, &CPU::ror, &CPU::rra,
-    &CPU::sei, &CPU::adc, &CPU::nop, &CPU::rra, &CPU::nop, &CPU::adc, &CPU::ror, &CPU::rra,
-    &CPU::nop, &CPU::sta, &CPU::nop, &CPU::sax, &CPU::sty, &CPU::sta, &CPU::stx, &CPU::sax,
-    &CPU::dey, &CPU::nop, &CPU::txa, &CPU::xaa, &CPU::sty, &CPU::sta, &CPU::stx, &CPU::sax,
-    &CPU::bcc, &CPU::sta, &CPU::kil, &CPU::ahx, &CPU::sty, &CPU::sta, &CPU::stx, &CPU::sax,
-    &CPU::tya, &CPU::sta, &CPU::txs, &CPU::tas, &CPU::shy, &CPU::sta, &CPU::shx, &CPU::ahx,
-    &CPU::ldy, &CPU::lda, &CPU::ldx, &CPU::lax, &CPU::ldy, &CPU::lda, &CPU::ldx, &CPU::lax,
-    &CPU::tay, &CPU::lda, &CPU::tax, &CPU::lax, &CPU::ldy, &CPU::lda, &CPU::ldx, &CPU::lax,
-    &CPU::bcs, &CPU::lda, &CPU::kil, &CPU::lax, &CPU::ldy, &CPU::lda, &CPU::ldx, &CPU::lax,
-    &CPU::clv, &CPU::lda, &CPU::tsx, &CPU::las, &CPU::ldy, &CPU::lda, &CPU::ldx, &CPU::lax,
-    &CPU::cpy, &CPU::cmp, &CPU::nop, &CPU::dcp, &CPU::cpy, &CPU::cmp, &CPU::dec, &CPU::dcp,
-    &CPU::iny, &CPU::cmp, &CPU::dex, &CPU::axs, &CPU::cpy, &CPU::cmp, &CPU::dec, &CPU::dcp,
-    &CPU::bne, &CPU::cmp, &CPU::kil, &CPU::dcp, &CPU::nop, &CPU::cmp, &CPU::dec, &CPU::dcp,
-    &CPU::cld, &CPU::cmp, &CPU::nop, &CPU::dcp, &CPU::nop, &CPU::cmp, &CPU::dec, &CPU::dcp,
-    &CPU::cpx, &CPU::sbc, &CPU::nop, &CPU::isb, &CPU::cpx, &CPU::sbc, &CPU::inc, &CPU::isb,
-    &CPU::inx, &CPU::sbc, &CPU::nop, &CPU::sbc, &CPU::cpx, &CPU::sbc, &CPU::inc, &CPU::isb,
-    &CPU::beq, &CPU::sbc, &CPU::kil, &CPU::isb, &CPU::nop, &CPU::sbc, &CPU::inc, &CPU::isb,
-    &CPU::sed, &CPU::sbc, &CPU::nop, &CPU::isb, &CPU::nop, &CPU::sbc, &CPU::inc, &CPU::isb,
-  }
+  mem(console),
+  console(console)
 {
   // set initial state
   A = 0;
@@ -69,10 +81,32 @@ CPU::CPU(Console& console):
   N = false;  // Negative
   clock = 0;
   cyclesToWait = 0;
+  instructionCount = 0;
+  cycleCount = 0;
+  trace = NULL;
+  guestProfiler = NULL;
   latestInstruction = 0x04; // NOP
   log.setLevel(INFO);
 }
 
+CPU::CPU(Console& console, CPU& other):
+  log(other.log),
+  mem(console, other.mem),
+  console(console),
+  A(other.A), X(other.X), Y(other.Y),
+  sp(other.sp),
+  pc(other.pc),
+  C(other.C), Z(other.Z), I(other.I), D(other.D),
+  B(other.B), U(other.U), O(other.O), N(other.N),
+  clock(other.clock),
+  cyclesToWait(other.cyclesToWait),
+  instructionCount(other.instructionCount),
+  cycleCount(other.cycleCount),
+  trace(NULL),
+  guestProfiler(NULL),
+  latestInstruction(other.latestInstruction)
+{}
+
 /* PUBLIC FUNCTIONS */
 CPUStateData CPU::dumpState() {
   CPUStateData data;
@@ -87,12 +121,89 @@ CPUStateData CPU::dumpState() {
   return data;
 }
 
+void CPU::save(utils::StateBuffer& state) {
+  state.write(A);
+  state.write(X);
+  state.write(Y);
+  state.write(sp);
+  state.write(pc);
+  state.write(getFlags());
+  state.write(clock);
+  state.write(cyclesToWait);
+  state.write(latestInstruction);
+  mem.save(state);
+}
+
+void CPU::load(utils::StateBuffer& state) {
+  uint8_t flags;
+  state.read(A);
+  state.read(X);
+  state.read(Y);
+  state.read(sp);
+  state.read(pc);
+  state.read(flags);
+  setFlags(flags);
+  state.read(clock);
+  state.read(cyclesToWait);
+  state.read(latestInstruction);
+  mem.load(state);
+}
+
+long CPU::getInstructionCount() { return instructionCount; }
+
 CPUMemory& CPU::getMemory() {
     return mem;
 }
 
 void CPU::debugSetPc(uint16_t address) { pc = address; }
 
+void CPU::setGuestProfiler(GuestProfiler *profiler) { guestProfiler = profiler; }
+
+void CPU::setTrace(utils::TraceRing *t) { trace = t; }
+
+std::string CPU::disassemble(uint16_t pc, uint8_t opcode, uint8_t low, uint8_t high) {
+  uint16_t absolute = low | (high << 8);
+  char operand[16] = "";
+  switch (instructionModes[opcode]) {
+    case ABSOLUTE_MODE: snprintf(operand, sizeof(operand), "$%04X", absolute); break;
+    case ABSOLUTEX_MODE: snprintf(operand, sizeof(operand), "$%04X,X", absolute); break;
+    case ABSOLUTEY_MODE: snprintf(operand, sizeof(operand), "$%04X,Y", absolute); break;
+    case ACCUMULATOR_MODE: snprintf(operand, sizeof(operand), "A"); break;
+    case IMMEDIATE_MODE: snprintf(operand, sizeof(operand), "#$%02X", low); break;
+    case INDEXED_INDIRECT_MODE: snprintf(operand, sizeof(operand), "($%02X,X)", low); break;
+    case INDIRECT_MODE: snprintf(operand, sizeof(operand), "($%04X)", absolute); break;
+    case INDIRECT_INDEXED_MODE: snprintf(operand, sizeof(operand), "($%02X),Y", low); break;
+    case RELATIVE_MODE: snprintf(operand, sizeof(operand), "$%04X", (uint16_t)(pc + 2 + (int8_t)low)); break;
+    case ZERO_PAGE_MODE: snprintf(operand, sizeof(operand), "$%02X", low); break;
+    case ZERO_PAGEX_MODE: snprintf(operand, sizeof(operand), "$%02X,X", low); break;
+    case ZERO_PAGEY_MODE: snprintf(operand, sizeof(operand), "$%02X,Y", low); break;
+  }
+  std::string text = instructionNames[opcode];
+  if (operand[0] != 0)
+    text += std::string(" ") + operand;
+  return instructionOfficial[opcode] ? text : "*" + text;
+}
+
+void CPU::recordTrace() {
+  utils::TraceRecord r;
+  PPUStateData ppu = console.getPpu().dumpState();
+  r.cycle = cycleCount;
+  r.pc = pc;
+  r.scanLine = ppu.scanLine;
+  r.dot = ppu.clock;
+  r.opcode = mem.read(pc);
+  // only read the operands that exist, as reads can have side effects
+  int size = instructionSizes[r.opcode];
+  r.operands[0] = size > 1 ? mem.read(pc + 1) : 0;
+  r.operands[1] = size > 2 ? mem.read(pc + 2) : 0;
+  r.A = A;
+  r.X = X;
+  r.Y = Y;
+  r.P = getFlags();
+  r.sp = sp;
+  trace->write(r);
+}
+
 void CPU::waitFor(int cycles) { cyclesToWait += cycles; } 
 
 void CPU::fastForwardClock(long ticks) { 
@@ -101,14 +212,20 @@ void CPU::fastForwardClock(long ticks) {
 }
 
 long CPU::step() {
-  log.debug() << dumpState() << "\n";
+  PROFILE_SCOPE(CPU_ZONE);
   if (cyclesToWait > 0) {
     // simulates CPU doing copy op to PPU memory
     cyclesToWait--;
     clock++;
+    cycleCount++;
+    GUEST_PROFILE(guestProfiler, onWait(1));
     return 1;
   }
+  if (trace != NULL)
+    recordTrace();
   // read instruction
+  instructionCount++;
+  GUEST_PROFILE(guestProfiler, onFetch(pc));
   uint8_t opcode = nextByte();
   AddressingMode mode = static_cast<AddressingMode>(CPU::instructionModes[opcode]);
   // determine address
@@ -199,14 +316,18 @@ long CPU::step() {
   clock += instructionCycles[opcode];
   if (pageChanged)
     clock += instructionCyclesExtra[opcode];
-      
-  return clock - startClock;
+  long cycles = clock - startClock;
+  cycleCount += cycles;
+  GUEST_PROFILE(guestProfiler, onInstruction(opcode, cycles, pc, sp));
+  return cycles;
 }
 
 void CPU::reset() {
   interrupt(RESET);
   sp = 0xfd;
   setFlags(0b100100);
+  // the reset sequence takes 7 cycles
+  cycleCount += 7;
 }
 
 void CPU::triggerNmi() {
@@ -219,6 +340,7 @@ void CPU::triggerIrq() {
 
 /* PRIVATE FUNCTIONS */
 void CPU::interrupt(InterruptType interrupt) {
+  DEBUG_COUNT(INTERRUPTS);
   if (interrupt != RESET) {
     uint8_t currentFlags = getFlags();
     if (interrupt == BRK)
@@ -246,6 +368,13 @@ void CPU::interrupt(InterruptType interrupt) {
       cyclesToWait += 7;
       break;
   }
+  if (interrupt == RESET) {
+    GUEST_PROFILE(guestProfiler, onReset());
+  } else {
+    GUEST_PROFILE(guestProfiler, onInterrupt(
+      interrupt == NMI ? GuestProfiler::NMI : interrupt == IRQ ? GuestProfiler::IRQ : GuestProfiler::BRK,
+      pc, sp));
+  }
 }
 
 void CPU::pushStack(uint8_t value) {
@@ -0,0 +1,223 @@
+#include "guest_profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+
+#include "console.h"
+#include "cpu.h"
+#include "mapper.h"
+
+const uint32_t GuestProfiler::RAM_BANK;
+
+namespace {
+// opcodes changing the call tree
+const uint8_t JSR = 0x20;
+const uint8_t RTS = 0x60;
+const uint8_t RTI = 0x40;
+// function of the root of the call tree
+const uint32_t ROOT = 0xffffffff;
+
+double percent(uint64_t part, uint64_t total) {
+  return total > 0 ? 100.0 * part / total : 0;
+}
+} // namespace
+
+GuestProfiler::GuestProfiler(Console& c):
+  console(c),
+  lastPc(0), totalCycles(0), instructions(0),
+  ramCycles(0x8000),
+  opcodeCounts(), opcodeCycles(),
+  nodes(1, Node{ROOT, -1, {}, 0}),
+  currentNode(0)
+{}
+
+void GuestProfiler::onInstruction(uint8_t opcode, int cycles, uint16_t pc, uint8_t sp) {
+  instructions++;
+  opcodeCounts[opcode]++;
+  opcodeCycles[opcode] += cycles;
+  count(cycles);
+  // the cycles of a JSR count for the caller, and those of RTS for the
+  // function that returns
+  switch (opcode) {
+    case JSR:
+      // the return address was pushed
+      enter(CALL, pc, sp + 2);
+      break;
+    case RTS:
+    case RTI:
+      leave(sp);
+      break;
+  }
+}
+
+void GuestProfiler::onWait(int cycles) {
+  count(cycles);
+}
+
+void GuestProfiler::onInterrupt(EntryKind kind, uint16_t handler, uint8_t sp) {
+  // the return address and the flags were pushed
+  enter(kind, handler, sp + 3);
+}
+
+void GuestProfiler::onReset() {
+  stack.clear();
+  currentNode = 0;
+}
+
+void GuestProfiler::count(int cycles) {
+  totalCycles += cycles;
+  nodes[currentNode].cycles += cycles;
+  if (lastPc < 0x8000) {
+    ramCycles[lastPc] += cycles;
+    return;
+  }
+  size_t offset = console.getMapper()->prgRomOffset(lastPc);
+  if (offset >= romCycles.size()) {
+    size_t size = (offset / BANK_SIZE + 1) * BANK_SIZE;
+    romCycles.resize(size);
+    romAddresses.resize(size);
+  }
+  romCycles[offset] += cycles;
+  romAddresses[offset] = lastPc;
+}
+
+uint32_t GuestProfiler::locate(uint16_t address) {
+  uint32_t bank = RAM_BANK;
+  if (address >= 0x8000)
+    bank = console.getMapper()->prgRomOffset(address) / BANK_SIZE;
+  return (bank << 16) | address;
+}
+
+void GuestProfiler::enter(EntryKind kind, uint16_t address, uint8_t returnSp) {
+  // code that does not return with RTS (or manipulates the stack) leaves
+  // frames behind, so the depth has to be bounded
+  if (stack.size() >= MAX_DEPTH)
+    return;
+  uint32_t function = ((uint32_t)kind << 24) | locate(address);
+  auto child = nodes[currentNode].children.find(function);
+  int node;
+  if (child != nodes[currentNode].children.end()) {
+    node = child->second;
+  } else {
+    node = nodes.size();
+    nodes.push_back(Node{function, currentNode, {}, 0});
+    nodes[currentNode].children[function] = node;
+  }
+  stack.push_back(Frame{node, returnSp});
+  currentNode = node;
+}
+
+// leave pops all the functions that returned, as some code pulls return
+// addresses to return several levels at once
+void GuestProfiler::leave(uint8_t sp) {
+  while (!stack.empty() && sp >= stack.back().returnSp)
+    stack.pop_back();
+  currentNode = stack.empty() ? 0 : stack.back().node;
+}
+
+std::string GuestProfiler::name(uint32_t function) {
+  if (function == ROOT)
+    return "main";
+  static const char *prefixes[] = {"", "nmi:", "irq:", "brk:"};
+  uint32_t bank = (function >> 16) & 0xff;
+  char buffer[32];
+  if (bank == RAM_BANK)
+    snprintf(buffer, sizeof(buffer), "%sRAM:$%04X", prefixes[function >> 24], function & 0xffff);
+  else
+    snprintf(buffer, sizeof(buffer), "%s%02X:$%04X", prefixes[function >> 24], bank, function & 0xffff);
+  return buffer;
+}
+
+void GuestProfiler::writeReport(std::ostream& out, int top) {
+  out << "guest profile: " << instructions << " instructions, " << totalCycles << " cycles\n";
+  out << std::fixed << std::setprecision(2);
+
+  out << "\nbanks\n";
+  std::vector<std::pair<uint64_t, uint32_t>> banks;
+  for (size_t bank = 0; bank < romCycles.size() / BANK_SIZE; bank++) {
+    uint64_t cycles = 0;
+    for (size_t i = 0; i < BANK_SIZE; i++)
+      cycles += romCycles[bank * BANK_SIZE + i];
+    banks.push_back({cycles, bank});
+  }
+  uint64_t ram = 0;
+  for (auto c: ramCycles)
+    ram += c;
+  banks.push_back({ram, RAM_BANK});
+  std::sort(banks.rbegin(), banks.rend());
+  for (auto& b: banks) {
+    if (b.first == 0)
+      break;
+    char bank[8];
+    snprintf(bank, sizeof(bank), b.second == RAM_BANK ? "RAM" : "%02X", b.second);
+    out << "  " << std::left << std::setw(12) << bank << std::right
+      << std::setw(14) << b.first << std::setw(8) << percent(b.first, totalCycles) << "%\n";
+  }
+
+  out << "\nlocations\n";
+  std::vector<std::pair<uint64_t, uint32_t>> locations;
+  for (size_t i = 0; i < romCycles.size(); i++) {
+    if (romCycles[i] > 0)
+      locations.push_back({romCycles[i], ((i / BANK_SIZE) << 16) | romAddresses[i]});
+  }
+  for (size_t i = 0; i < ramCycles.size(); i++) {
+    if (ramCycles[i] > 0)
+      locations.push_back({ramCycles[i], (RAM_BANK << 16) | i});
+  }
+  std::sort(locations.rbegin(), locations.rend());
+  for (int i = 0; i < top && i < (int)locations.size(); i++) {
+    out << "  " << std::left << std::setw(12) << name(locations[i].second) << std::right
+      << std::setw(14) << locations[i].first << std::setw(8) << percent(locations[i].first, totalCycles) << "%\n";
+  }
+
+  // self and total (including callees) cycles of each function, over all
+  // the places it was called from
+  out << "\nfunctions" << std::setw(23) << "self" << std::setw(23) << "total" << "\n";
+  std::vector<uint64_t> inclusive(nodes.size());
+  std::map<uint32_t, std::pair<uint64_t, uint64_t>> functions;
+  for (int n = nodes.size() - 1; n >= 0; n--) {
+    // children are always created after their parent
+    inclusive[n] += nodes[n].cycles;
+    if (nodes[n].parent >= 0)
+      inclusive[nodes[n].parent] += inclusive[n];
+    functions[nodes[n].function].first += nodes[n].cycles;
+    functions[nodes[n].function].second += inclusive[n];
+  }
+  std::vector<std::pair<uint64_t, uint32_t>> byTotal;
+  for (auto& f: functions)
+    byTotal.push_back({f.second.second, f.first});
+  std::sort(byTotal.rbegin(), byTotal.rend());
+  for (int i = 0; i < top && i < (int)byTotal.size(); i++) {
+    uint64_t self = functions[byTotal[i].second].first;
+    out << "  " << std::left << std::setw(16) << name(byTotal[i].second) << std::right
+      << std::setw(14) << self << std::setw(8) << percent(self, totalCycles) << "%"
+      << std::setw(14) << byTotal[i].first << std::setw(8) << percent(byTotal[i].first, totalCycles) << "%\n";
+  }
+
+  out << "\nopcodes" << std::setw(21) << "count" << std::setw(14) << "cycles" << "\n";
+  std::vector<std::pair<uint64_t, int>> opcodes;
+  for (int op = 0; op < 256; op++) {
+    if (opcodeCounts[op] > 0)
+      opcodes.push_back({opcodeCycles[op], op});
+  }
+  std::sort(opcodes.rbegin(), opcodes.rend());
+  for (auto& o: opcodes) {
+    char opcode[16];
+    snprintf(opcode, sizeof(opcode), "$%02X %s", o.second, instructionNames[o.second].c_str());
+    out << "  " << std::left << std::setw(12) << opcode << std::right
+      << std::setw(14) << opcodeCounts[o.second] << std::setw(14) << o.first
+      << std::setw(8) << percent(o.first, totalCycles) << "%\n";
+  }
+}
+
+void GuestProfiler::writeFolded(std::ostream& out) {
+  writeFolded(out, 0, name(ROOT));
+}
+
+void GuestProfiler::writeFolded(std::ostream& out, int node, std::string path) {
+  if (nodes[node].cycles > 0)
+    out << path << " " << nodes[node].cycles << "\n";
+  for (auto& child: nodes[node].children)
+    writeFolded(out, child.second, path + ";" + name(child.first));
+}
@@ -1,9 +1,12 @@
+#include <algorithm>
 #include <cerrno>
 #include <cstring>
 #include <iostream>
 
 #include "mapper.h"
 #include "console.h"
+#include "hash.h"
+#include "instrumentation.h"
 
 
 std::runtime_error invalidNesFileError(std::string fileName) {
@@ -40,42 +43,69 @@ Mapper *Mapper::fromNesFile(Console& c, std::string fileName) {
 
   // parse header object and return adequate mapper
   NESHeader header = parseHeader(rawHeader);
+  size_t romSize = header.prgRomSize * PRG_ROM_UNIT + header.chrRomSize * CHR_ROM_UNIT;
+  if (rawData.size() < romSize)
+    rawData.resize(romSize);
+  std::shared_ptr<const std::vector<uint8_t>> rom =
+    std::make_shared<std::vector<uint8_t>>(std::move(rawData));
   switch(header.mapperId){
     case 0:
-      return new NROMMapper(c, header, rawData);
+      return new NROMMapper(c, header, rom);
     case 4:
-      return new MMC3Mapper(c, header, rawData);
+      return new MMC3Mapper(c, header, rom);
     default:
       throw mapperNotImplementedError("mapper id n" + std::to_string(header.mapperId));
   }
 }
 
-Mapper::Mapper(Console& c, NESHeader header, const std::vector<uint8_t>& rawData):
+Mapper::Mapper(Console& c, NESHeader h, std::shared_ptr<const std::vector<uint8_t>> romData):
   log(Logger::getLogger("Mapper", "mapper.log")),
-  mirror(PPUMirror::fromId(header.mirrorId)),
+  header(h),
+  mirror(PPUMirror::fromId(h.mirrorId)),
   console(c),
-  prgRom(new uint8_t[header.prgRomSize * PRG_ROM_UNIT]),
-  prgRam(new uint8_t[header.prgRamSize * PRG_RAM_UNIT]),
-  chrRom(new uint8_t[header.chrRomSize * CHR_ROM_UNIT])
+  rom(romData),
+  prgRom(rom->data()),
+  chrRom(rom->data() + h.prgRomSize * PRG_ROM_UNIT),
+  prgRomSize(h.prgRomSize),
+  // TODO: should there really be a unit of PRG RAM when the header says 0?
+  prgRam(std::max(h.prgRamSize, 1) * PRG_RAM_UNIT),
+  // if there is no CHR ROM, then there is one unit of CHR RAM instead
+  // TODO: this assumes iNES and not NES2.0
+  chrRam(h.chrRomSize == 0 ? CHR_ROM_UNIT : 0)
 {
   log.setLevel(INFO);
   log.info() << header << "\n";
-  int j = 0;
-  for (int i = 0; i < header.prgRomSize * PRG_ROM_UNIT; i++)
-    prgRom[i] = rawData[j++];
-  for (int i = 0; i < header.chrRomSize * CHR_ROM_UNIT; i++)
-    chrRom[i] = rawData[j++];
-  
-  if (header.chrRomSize == 0) {
-    // then "chrRom" is in fact "chrRam" and we want to give it a size of one
-    // TODO: do this more cleanly, also this assumes iNES and not NES2.0
-    chrRom = new uint8_t[CHR_ROM_UNIT];
-  }
-  if (header.prgRamSize == 0) {
-    // TODO: should that really be there?
-    prgRam = new  uint8_t[PRG_RAM_UNIT];
-  }
-  prgRomSize = header.prgRomSize;
+}
+
+Mapper::Mapper(Console& c, Mapper& other):
+  log(other.log),
+  header(other.header),
+  mirror(PPUMirror::fromId(other.header.mirrorId)),
+  console(c),
+  rom(other.rom),
+  prgRom(other.prgRom),
+  chrRom(other.chrRom),
+  prgRomSize(other.prgRomSize),
+  prgRam(other.prgRam),
+  chrRam(other.chrRam)
+{}
+
+Mapper::~Mapper() {
+  delete mirror;
+}
+
+void Mapper::save(utils::StateBuffer& state) {
+  prgRam.save(state);
+  chrRam.save(state);
+}
+
+void Mapper::load(utils::StateBuffer& state) {
+  prgRam.load(state);
+  chrRam.load(state);
+}
+
+uint32_t Mapper::romHash() {
+  return utils::crc32(rom->data(), rom->size());
 }
 
 uint16_t Mapper::mirrorAddress(uint16_t address) {
@@ -86,22 +116,33 @@ uint16_t Mapper::mirrorAddress(uint16_t address) {
   return pointer;
 }
 
-NROMMapper::NROMMapper(Console& c, NESHeader h, const std::vector<uint8_t>& d):
+NROMMapper::NROMMapper(Console& c, NESHeader h, std::shared_ptr<const std::vector<uint8_t>> d):
   Mapper(c, h, d),
   // NROM-128 have 16kB of PRG_ROM, NROM-256 have 32kB
   isNrom_128((h.prgRomSize > 1) ? false : true)
 {}
 
+NROMMapper::NROMMapper(Console& c, NROMMapper& other):
+  Mapper(c, other),
+  isNrom_128(other.isNrom_128)
+{}
+
+Mapper *NROMMapper::clone(Console& c) { return new NROMMapper(c, *this); }
+
 uint8_t NROMMapper::readPrg(uint16_t address) {
   if (address < 0x8000)
-    return prgRam[address - 0x6000];
+    return prgRam.read(address - 0x6000);
   else
     return isNrom_128 ? prgRom[(address - 0x8000) % 0x4000] : prgRom[address - 0x8000];
 }
 
+int NROMMapper::prgRomOffset(uint16_t address) {
+  return isNrom_128 ? (address - 0x8000) % 0x4000 : address - 0x8000;
+}
+
 void NROMMapper::writePrg(uint16_t address, uint8_t value) {
   if (address < 0x8000)
-    prgRam[address - 0x6000] = value;
+    prgRam.write(address - 0x6000, value);
   else
     log.error() << "Trying to write prg at " << hex(address) << "\n";
 }
@@ -110,11 +151,11 @@ void NROMMapper::writePrg(uint16_t address, uint8_t value) {
 void NROMMapper::clockIRQCounter() {}
 
 uint8_t NROMMapper::readChr(uint16_t address) {
-  return chrRom[address];
+  return readChrMemory(address);
 }
 
 void NROMMapper::writeChr(uint16_t address, uint8_t value) {
-  chrRom[address] = value;
+  writeChrMemory(address, value);
 }
 
 PPUMirror* PPUMirror::fromId(int id) {
@@ -142,8 +183,12 @@ int HorizontalMirror::getTable(int num) {
   return mirrorPattern[num];
 }
 
-MMC3Mapper::MMC3Mapper(Console& c, NESHeader h, const std::vector<uint8_t>& d):
-  Mapper(c, h, d)
+MMC3Mapper::MMC3Mapper(Console& c, NESHeader h, std::shared_ptr<const std::vector<uint8_t>> d):
+  Mapper(c, h, d),
+  currentBank(0), bankIndexes{0},
+  prgROMMode(false), chrInversion(false),
+  IRQCounter(0), IRQLatch(0), IRQReload(false), IRQEnabled(false),
+  isHorizontalMirroring(false)
 {
   cpuOffsets[0] = computeCpuOffset(0);
   cpuOffsets[1] = computeCpuOffset(1);
@@ -160,6 +205,51 @@ MMC3Mapper::MMC3Mapper(Console& c, NESHeader h, const std::vector<uint8_t>& d):
   ppuOffsets[7] = computePpuOffset(7);
 }
 
+MMC3Mapper::MMC3Mapper(Console& c, MMC3Mapper& other):
+  Mapper(c, other),
+  currentBank(other.currentBank),
+  prgROMMode(other.prgROMMode), chrInversion(other.chrInversion),
+  IRQCounter(other.IRQCounter), IRQLatch(other.IRQLatch),
+  IRQReload(other.IRQReload), IRQEnabled(other.IRQEnabled),
+  isHorizontalMirroring(other.isHorizontalMirroring)
+{
+  std::copy(other.bankIndexes, other.bankIndexes + 8, bankIndexes);
+  std::copy(other.cpuOffsets, other.cpuOffsets + 4, cpuOffsets);
+  std::copy(other.ppuOffsets, other.ppuOffsets + 8, ppuOffsets);
+}
+
+Mapper *MMC3Mapper::clone(Console& c) { return new MMC3Mapper(c, *this); }
+
+void MMC3Mapper::save(utils::StateBuffer& state) {
+  Mapper::save(state);
+  state.write(currentBank);
+  state.write(bankIndexes);
+  state.write(cpuOffsets);
+  state.write(ppuOffsets);
+  state.write(prgROMMode);
+  state.write(chrInversion);
+  state.write(IRQCounter);
+  state.write(IRQLatch);
+  state.write(IRQReload);
+  state.write(IRQEnabled);
+  state.write(isHorizontalMirroring);
+}
+
+void MMC3Mapper::load(utils::StateBuffer& state) {
+  Mapper::load(state);
+  state.read(currentBank);
+  state.read(bankIndexes);
+  state.read(cpuOffsets);
+  state.read(ppuOffsets);
+  state.read(prgROMMode);
+  state.read(chrInversion);
+  state.read(IRQCounter);
+  state.read(IRQLatch);
+  state.read(IRQReload);
+  state.read(IRQEnabled);
+  state.read(isHorizontalMirroring);
+}
+
 // readPrg returns the byte stored in PRGROM for this address
 // 
 // It works by finding which page the address belongs to, then reading from the
@@ -170,21 +260,21 @@ uint8_t MMC3Mapper::readPrg(uint16_t address){
     return 0;
   }
   if (address < 0x8000) {
-    return prgRam[address - 0x6000];
+    return prgRam.read(address - 0x6000);
   }
   int index = (address - 0x8000) / MMC3Mapper::PRG_PAGE_SIZE;
   int offset = (address - 0x8000) % MMC3Mapper::PRG_PAGE_SIZE;
   int redirectedAddress = cpuOffsets[index] + offset;
   uint8_t value = prgRom[redirectedAddress];
-  log.debug() << "read " << hex(value) << " at " << hex(address) << "\n";
-  log.debug() << "offset " << hex(cpuOffsets[index]) << "\n";
-  log.debug() << "offset " << offset << " index " << index << "\n";
+  DEBUG_LOG(log) << "read " << hex(value) << " at " << hex(address) << "\n";
+  DEBUG_LOG(log) << "offset " << hex(cpuOffsets[index]) << "\n";
+  DEBUG_LOG(log) << "offset " << offset << " index " << index << "\n";
 
   return value;
 }
 
 uint8_t MMC3Mapper::readChr(uint16_t address){
-  log.debug() << "Attempted mapper read addr=" << hex(address) << "\n";
+  DEBUG_LOG(log) << "Attempted mapper read addr=" << hex(address) << "\n";
   if (address > 0x2000) {
     log.error() << "Trying to read CHR at " << hex(address) << "\n";
     return 0;
@@ -192,17 +282,23 @@ uint8_t MMC3Mapper::readChr(uint16_t address){
   int index = address / MMC3Mapper::CHR_PAGE_SIZE;
   int offset = address % MMC3Mapper::CHR_PAGE_SIZE;
   int redirectedAddress = ppuOffsets[index] + offset;
-  return chrRom[redirectedAddress];
+  return readChrMemory(redirectedAddress);
+}
+
+int MMC3Mapper::prgRomOffset(uint16_t address) {
+  int index = (address - 0x8000) / MMC3Mapper::PRG_PAGE_SIZE;
+  int offset = (address - 0x8000) % MMC3Mapper::PRG_PAGE_SIZE;
+  return cpuOffsets[index] + offset;
 }
 
 // writePrg is called for address >= 0x8000
 void MMC3Mapper::writePrg(uint16_t address, uint8_t value) {
-  log.debug() << "write " << hex(value) << " at " << hex(address) << "\n";
+  DEBUG_LOG(log) << "write " << hex(value) << " at " << hex(address) << "\n";
   if (address < 0x6000) {
     log.error() << "Trying to write PRG at " <<  hex(address) << "\n";
   }
   else if (address < 0x8000)  {
-    prgRam[address - 0x6000] = value;
+    prgRam.write(address - 0x6000, value);
   }
   else if (address < 0xa000 && address % 2 == 0) {
     writeBankSelect(value);
@@ -238,7 +334,7 @@ void MMC3Mapper::writeChr(uint16_t address, uint8_t value) {
   int index = address / MMC3Mapper::CHR_PAGE_SIZE;
   int offset = address % MMC3Mapper::CHR_PAGE_SIZE;
   int redirectedAddress = ppuOffsets[index] + offset;
-  chrRom[redirectedAddress] = value;
+  writeChrMemory(redirectedAddress, value);
 }
 
 // writeBankSelect sets internal MMC3 values according to value
@@ -265,6 +361,7 @@ void MMC3Mapper::writeBankData(uint8_t value) {
 // setCpuOffsets assigns the 4 cpu memory pages (0x8000 thru 0xffff) to
 // different locations in prgRom
 void MMC3Mapper::setCpuOffsets() {
+  DEBUG_COUNT(BANK_SWITCHES);
   // in all cases, 0xa000 - 0xbfff has the page index given by the last bank
   // MMC3 is capped at 64 pages of prgROM, so ignore the two uper bits
   cpuOffsets[1] = computeCpuOffset(bankIndexes[7] & 63);
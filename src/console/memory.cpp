@@ -1,9 +1,11 @@
 #include "memory.h"
 
+#include <algorithm>
 // TODO: remove
 #include <iostream>
 
 #include "console.h"
+#include "instrumentation.h"
 #include "mapper.h"
 
 /* 
@@ -52,15 +54,32 @@ Memory::Memory(Console& c, Logger l):
 }
 
 CPUMemory::CPUMemory(Console& c):
-  Memory(c, Logger::getLogger("CPUMemory"))
+  Memory(c, Logger::getLogger("CPUMemory")),
+  ram(RAM_SIZE)
+{}
+
+CPUMemory::CPUMemory(Console& c, CPUMemory& other):
+  Memory(c, other.log),
+  ram(other.ram)
 {}
 
 PPUMemory::PPUMemory(Console& c):
-  Memory(c, Logger::getLogger("PPUMemory"))
+  Memory(c, Logger::getLogger("PPUMemory")),
+  palette{0},
+  nameTable(NAME_TABLE_SIZE)
 {}
 
+PPUMemory::PPUMemory(Console& c, PPUMemory& other):
+  Memory(c, other.log),
+  nameTable(other.nameTable)
+{
+  std::copy(other.palette, other.palette + PALETTE_SIZE, palette);
+}
+
 /* DEBUG FUNCTIONS */
 void Memory::debugDump(uint16_t offset, uint16_t range, uint16_t perLine) {
+  if (!log.isEnabled(DEBUG))
+    return;
   log.debug() << "Memory from " <<  hex(offset) << " to " << hex((uint16_t)(offset + range));
   log.toggleHeader();
   for (int i = 0; i < range; i++) {
@@ -76,9 +95,25 @@ void Memory::debugDump(uint16_t offset, uint16_t range, uint16_t perLine) {
 }
 
 /* PUBLIC FUNCTIONS */
+void CPUMemory::save(utils::StateBuffer& state) { ram.save(state); }
+
+void CPUMemory::load(utils::StateBuffer& state) { ram.load(state); }
+
+void PPUMemory::save(utils::StateBuffer& state) {
+  state.write(palette);
+  nameTable.save(state);
+}
+
+void PPUMemory::load(utils::StateBuffer& state) {
+  state.read(palette);
+  nameTable.load(state);
+}
+
 uint8_t CPUMemory::read(uint16_t address) {
+  DEBUG_COUNT(CPU_READS);
+  DEBUG_WATCH_READ(CPU_BUS, address);
   if (address < 0x2000)
-    return ram[address % CPUMemory::RAM_SIZE];
+    return ram.read(address % CPUMemory::RAM_SIZE);
   else if (address < 0x4000)
     return console.getPpu().readRegister(0x2000 + address % 8);
   else if (address == 0x4014) {
@@ -104,8 +139,10 @@ uint8_t CPUMemory::read(uint16_t address) {
 
 
 void CPUMemory::write(uint16_t address, uint8_t value) {
+  DEBUG_COUNT(CPU_WRITES);
+  DEBUG_WATCH_WRITE(CPU_BUS, address, value);
   if (address < 0x2000)
-    ram[address % CPUMemory::RAM_SIZE] = value;
+    ram.write(address % CPUMemory::RAM_SIZE, value);
   else if (address < 0x4000)
     console.getPpu().writeRegister(0x2000 + address % 8, value);
   else if (address == 0x4014)
@@ -127,10 +164,12 @@ void CPUMemory::write(uint16_t address, uint8_t value) {
 }
 
 uint8_t PPUMemory::read(uint16_t address) {
+  DEBUG_COUNT(PPU_READS);
+  DEBUG_WATCH_READ(PPU_BUS, address);
   if (address < 0x2000)
     return console.getMapper()->readChr(address);
   if (address < 0x3000)
-    return nameTable[console.getMapper()->mirrorAddress(address) - 0x2000];
+    return nameTable.read(console.getMapper()->mirrorAddress(address) - 0x2000);
   if ((0x3f00 <= address) && (address < 0x4000)) {
     uint16_t pointer =  address % 32;
     if (pointer >= 16 && (pointer % 4) == 0)
@@ -144,11 +183,13 @@ uint8_t PPUMemory::read(uint16_t address) {
 }
 
 void PPUMemory::write(uint16_t address, uint8_t value) {
+  DEBUG_COUNT(PPU_WRITES);
+  DEBUG_WATCH_WRITE(PPU_BUS, address, value);
   if (address < 0x2000)
     console.getMapper()->writeChr(address, value);
   else if (address < 0x3000) {
     uint16_t add = console.getMapper()->mirrorAddress(address) - 0x2000; 
-    nameTable[add] = value;
+    nameTable.write(add, value);
   }
   else if ((0x3f00 <= address) && (address < 0x4000)) {
     uint16_t pointer =  address % 32;
@@ -1,5 +1,6 @@
 #include "ppu.h"
 
+#include <algorithm>
 #include <string>
 #include <iostream>
 
@@ -7,6 +8,8 @@
 #include "cpu.h"
 #include "mapper.h"
 #include "io_interface.h"
+#include "instrumentation.h"
+#include "profiler.h"
 
 
 std::runtime_error invalidRegisterOp(std::string registerName, std::string op) {
@@ -143,7 +146,7 @@ uint8_t OAMADDR::read() {
   throw invalidRegisterOp("OAMADDR", "read");
 }
 
-OAMDATA::OAMDATA(PPU& _ppu): Register(_ppu) {}
+OAMDATA::OAMDATA(PPU& _ppu): Register(_ppu), data{0} {}
 
 void OAMDATA::write(uint8_t value) {
   data[ppu.getOamAddress()] = value;
@@ -323,11 +326,148 @@ PPU::PPU(Console& _console):
   backgroundData = 0; // 64 bits
 
   spriteCount = 0;
+  std::fill(spriteGraphics, spriteGraphics + 8, 0);
+  std::fill(spritePositions, spritePositions + 8, 0);
+  std::fill(spritePriorities, spritePriorities + 8, 0);
+  std::fill(spriteIndexes, spriteIndexes + 8, 0);
   // log.setLevel(DEBUG);
 
 }
 
 /* PUBLIC FUNCTIONS */
+PPU::PPU(Console& _console, PPU& other):
+  log(other.log),
+  mem(_console, other.mem),
+  console(_console),
+  ppuctrl(PPUCTRL(*this)),
+  ppumask(PPUMASK(*this)),
+  ppustatus(PPUSTATUS(*this)),
+  oamaddr(OAMADDR(*this)),
+  oamdata(OAMDATA(*this)),
+  ppuscroll(PPUSCROLL(*this)),
+  ppuaddr(PPUADDR(*this)),
+  ppudata(PPUDATA(*this)),
+  oamdma(OAMDMA(*this))
+{
+  utils::StateBuffer registers;
+  other.saveRegisters(registers);
+  loadRegisters(registers);
+}
+
+void PPU::save(utils::StateBuffer& state) {
+  saveRegisters(state);
+  mem.save(state);
+}
+
+void PPU::load(utils::StateBuffer& state) {
+  loadRegisters(state);
+  mem.load(state);
+}
+
+void PPU::saveRegisters(utils::StateBuffer& state) {
+  state.write(latchValue);
+  state.write(nmiOccured);
+  state.write(nmiPrevious);
+  state.write(nmiDelay);
+
+  state.write(ppuctrl.nametableFlag);
+  state.write(ppuctrl.incrementFlag);
+  state.write(ppuctrl.backgroundTableFlag);
+  state.write(ppuctrl.spriteTableFlag);
+  state.write(ppuctrl.spriteSizeFlag);
+  state.write(ppuctrl.masterSlaveFlag);
+  state.write(ppuctrl.nmiFlag);
+  state.write(ppumask.greyscaleFlag);
+  state.write(ppumask.leftBackgroundFlag);
+  state.write(ppumask.leftSpritesFlag);
+  state.write(ppumask.backgroundFlag);
+  state.write(ppumask.spritesFlag);
+  state.write(ppumask.redEmphasisFlag);
+  state.write(ppumask.greenEmphasisFlag);
+  state.write(ppumask.blueEmphasisFlag);
+  state.write(ppustatus.spriteOverflowFlag);
+  state.write(ppustatus.spriteZeroFlag);
+  state.write(ppustatus.verticalBlankStartedFlag);
+  state.write(oamaddr.address);
+  state.write(oamdata.data);
+  state.write(ppudata.bufferedValue);
+
+  state.write(currentVram);
+  state.write(temporaryVram);
+  state.write(fineScroll);
+  state.write(writeToggle);
+
+  state.write(clock);
+  state.write(frameCount);
+  state.write(scanLine);
+  state.write(isEvenScreen);
+
+  state.write(nameTableByte);
+  state.write(attributeTableByte);
+  state.write(lowerTileByte);
+  state.write(higherTileByte);
+  state.write(backgroundData);
+
+  state.write(spriteCount);
+  state.write(spriteGraphics);
+  state.write(spritePositions);
+  state.write(spritePriorities);
+  state.write(spriteIndexes);
+}
+
+void PPU::loadRegisters(utils::StateBuffer& state) {
+  state.read(latchValue);
+  state.read(nmiOccured);
+  state.read(nmiPrevious);
+  state.read(nmiDelay);
+
+  state.read(ppuctrl.nametableFlag);
+  state.read(ppuctrl.incrementFlag);
+  state.read(ppuctrl.backgroundTableFlag);
+  state.read(ppuctrl.spriteTableFlag);
+  state.read(ppuctrl.spriteSizeFlag);
+  state.read(ppuctrl.masterSlaveFlag);
+  state.read(ppuctrl.nmiFlag);
+  state.read(ppumask.greyscaleFlag);
+  state.read(ppumask.leftBackgroundFlag);
+  state.read(ppumask.leftSpritesFlag);
+  state.read(ppumask.backgroundFlag);
+  state.read(ppumask.spritesFlag);
+  state.read(ppumask.redEmphasisFlag);
+  state.read(ppumask.greenEmphasisFlag);
+  state.read(ppumask.blueEmphasisFlag);
+  state.read(ppustatus.spriteOverflowFlag);
+  state.read(ppustatus.spriteZeroFlag);
+  state.read(ppustatus.verticalBlankStartedFlag);
+  state.read(oamaddr.address);
+  state.read(oamdata.data);
+  state.read(ppudata.bufferedValue);
+
+  state.read(currentVram);
+  state.read(temporaryVram);
+  state.read(fineScroll);
+  state.read(writeToggle);
+
+  state.read(clock);
+  state.read(frameCount);
+  state.read(scanLine);
+  state.read(isEvenScreen);
+
+  state.read(nameTableByte);
+  state.read(attributeTableByte);
+  state.read(lowerTileByte);
+  state.read(higherTileByte);
+  state.read(backgroundData);
+
+  state.read(spriteCount);
+  state.read(spriteGraphics);
+  state.read(spritePositions);
+  state.read(spritePriorities);
+  state.read(spriteIndexes);
+}
+
+long PPU::getFrameCount() { return frameCount; }
+
 void PPU::reset() {
   clock = 340;
   scanLine = 240;
@@ -457,7 +597,14 @@ void PPU::nmiChange() {
 void PPU::nextScreen() {
   isEvenScreen = !isEvenScreen;
   frameCount++;
-  console.getInterface()->render();
+  if (!console.isOutputMuted()) {
+    // emphasis is applied to the whole frame, with its value at the end of it
+    console.getInterface()->setEmphasis(
+      ppumask.redEmphasisFlag | (ppumask.greenEmphasisFlag << 1) | (ppumask.blueEmphasisFlag << 2));
+    console.getInterface()->render();
+  }
+  console.endFrame();
+  PROFILE_END_FRAME();
 }
 
 int nextScanLine(int current) {
@@ -597,6 +744,7 @@ int PPU::fetchSpriteGraphics(int num, int row) {
 // loadSpriteData fetches the sprite information for all sprites of the next
 // scan line
 void PPU::loadSpriteData() {
+  PROFILE_SCOPE(PPU_SPRITES_ZONE);
   int height = ppuctrl.spriteSizeFlag ? 16 : 8;
   int _spriteCount = 0;
   int x, y, attributeData, top, bottom;
@@ -625,15 +773,18 @@ void PPU::loadSpriteData() {
   spriteCount = _spriteCount;
 }
 
+void PPU::debugLoadSpriteData(int line) {
+  scanLine = line;
+  loadSpriteData();
+}
+
 uint8_t PPU::getBackgroundPixel() {
   /* Gets pixel to render from the pre-loaded 64 bits of background data
    * The progressive shift is done in the main loop.
    * */
   if (!ppumask.backgroundFlag) return 0;
   uint32_t cycleData = backgroundData >> 32;
-  if (frameCount > 20 * 60) {
-    log.debug() << hex(backgroundData) << "cycle: " << hex(cycleData) << "\n";
-  }
+  DEBUG_LOG(log) << hex(backgroundData) << "cycle: " << hex(cycleData) << "\n";
   uint8_t pixelData = (cycleData >> (7 - fineScroll) * 4) & 0xf; 
   return pixelData;
 }
@@ -654,12 +805,10 @@ void PPU::loadBackgroundData() {
   // is done by looking at the 2 bit of the coarseX and coarseY scroll
   shift = ((currentVram >> 4) & 0b100) | (currentVram & 0b10);
   a = ((attributeTableByte >> shift) & 0b11) << 2;
-  if (frameCount > 20 * 60) {
-    log.debug() << "attr: " << hex(attributeTableByte) 
-                << "high: " << hex(higherTileByte)
-                << "vram: " << hex(currentVram)
-                << "low: " << hex(lowerTileByte) << "\n";
-  }
+  DEBUG_LOG(log) << "attr: " << hex(attributeTableByte)
+                 << "high: " << hex(higherTileByte)
+                 << "vram: " << hex(currentVram)
+                 << "low: " << hex(lowerTileByte) << "\n";
   for (int i = 0; i < 8; i ++) {
     b = (higherTileByte & 0x80) >> 6;
     c = (lowerTileByte & 0x80) >> 7;
@@ -668,9 +817,7 @@ void PPU::loadBackgroundData() {
     lowerTileByte <<= 1;
     data |= (a | b | c);
   }
-  if (frameCount > 20 * 60) {
-    log.debug() << "new data: " << hex(data) << "\n";
-  }
+  DEBUG_LOG(log) << "new data: " << hex(data) << "\n";
   backgroundData |= data;
 }
 
@@ -691,11 +838,9 @@ void PPU::fetchAttributeTableByte() {
   address |= (currentVram & 0x380) >> 4;
   address |= (currentVram & 0x1c) >> 2;
   attributeTableByte = mem.read(address);
-  if (frameCount > 20 * 60) {
-    log.debug() << "addr: " << hex(address) 
-                << " vram: " << hex(currentVram)
-                << " attr: " << hex(attributeTableByte) << "\n";
-  }
+  DEBUG_LOG(log) << "addr: " << hex(address)
+                 << " vram: " << hex(currentVram)
+                 << " attr: " << hex(attributeTableByte) << "\n";
 }
 
 void PPU::fetchLowerTileByte() {
@@ -821,9 +966,8 @@ void PPU::renderPixel() {
       color =  background;
   }
   uint8_t paletteInfo = mem.read(0x3f00 + color % 64);
-  if (frameCount > 20 * 60) {
-    log.debug() << "sprite: " << hex(spritePix.color) << "back: " << hex(background) << "\n";
-    log.debug() << "(" << x << "," << y << ")" << ": " << hex(paletteInfo) << "\n";
-  }
-  console.getInterface()->colorPixel(x, y, paletteInfo);
+  DEBUG_LOG(log) << "sprite: " << hex(spritePix.color) << "back: " << hex(background) << "\n";
+  DEBUG_LOG(log) << "(" << x << "," << y << ")" << ": " << hex(paletteInfo) << "\n";
+  if (!console.isOutputMuted())
+    console.getInterface()->colorPixel(x, y, paletteInfo);
 }
@@ -0,0 +1,152 @@
+#include "rewind.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "console.h"
+#include "varint.h"
+
+
+// a span of XORed bytes is closed once this many identical bytes follow it, as
+// starting a new span costs about as much as storing a few zeros
+const size_t MIN_GAP = 4;
+
+Rewinder::Rewinder(Console& c, int _interval, int capacity):
+  log(Logger::getLogger("Rewinder")),
+  console(c),
+  interval(_interval),
+  framesSinceCapture(0),
+  captureCount(0),
+  head(-1),
+  count(0),
+  ringBytes(0)
+{
+  if (interval <= 0) {
+    throw std::runtime_error("the rewind interval must be at least one frame");
+  }
+  if (capacity <= 0) {
+    throw std::runtime_error("the rewind capacity must be at least one entry");
+  }
+  ring.resize(capacity);
+  log.setLevel(INFO);
+}
+
+void Rewinder::record() {
+  framesSinceCapture++;
+  if (framesSinceCapture < interval) {
+    return;
+  }
+  framesSinceCapture = 0;
+
+  capture.clear();
+  console.save(capture);
+  captureCount++;
+  if (latest.size() != capture.size()) {
+    // first capture (the size of the state never changes for a given
+    // cartridge): there is nothing to diff against yet
+    std::swap(latest, capture);
+    return;
+  }
+
+  head = (head + 1) % ring.size();
+  if (count < (int)ring.size()) {
+    count++;
+  } else {
+    // the ring is full, head points to the oldest entry which is overwritten
+    ringBytes -= ring[head].size();
+  }
+  encodeDelta(latest.data(), capture.data(), capture.size(), ring[head]);
+  ringBytes += ring[head].size();
+  std::swap(latest, capture);
+
+  if (captureCount % capturesPerMinute() == 0) {
+    LOG_INFO(log) << "history: " << count << " entries, " << memoryUsage()
+                  << " bytes, " << bytesPerMinute() << " bytes per minute\n";
+  }
+}
+
+bool Rewinder::stepBack() {
+  if (latest.size() == 0) {
+    return false;
+  }
+  framesSinceCapture = 0;
+  latest.seekStart();
+  console.load(latest);
+  if (count == 0) {
+    return false;
+  }
+
+  applyDelta(ring[head], latest.data(), latest.size());
+  ringBytes -= ring[head].size();
+  ring[head].clear();
+  head = (head - 1 + ring.size()) % ring.size();
+  count--;
+  return true;
+}
+
+long Rewinder::memoryUsage() {
+  return ringBytes + latest.size();
+}
+
+long Rewinder::bytesPerMinute() {
+  if (count == 0) {
+    return 0;
+  }
+  return ringBytes / count * capturesPerMinute();
+}
+
+// capturesPerMinute is at least one, even when captures are more than a minute
+// apart
+long Rewinder::capturesPerMinute() {
+  return std::max(1, 60 * 60 / interval);
+}
+
+// encodeDelta writes the XOR of a and b as a series of spans, each one being
+// encoded as:
+//  - the number of identical bytes since the end of the previous span (varint)
+//  - the length of the span (varint)
+//  - the XORed bytes of the span
+void Rewinder::encodeDelta(const uint8_t* a, const uint8_t* b, size_t size, std::vector<uint8_t>& out) {
+  out.clear();
+  size_t previousEnd = 0;
+  size_t i = 0;
+  while (i < size) {
+    if (a[i] == b[i]) {
+      i++;
+      continue;
+    }
+    size_t start = i;
+    size_t end = i;
+    // extend the span until MIN_GAP identical bytes in a row are found
+    while (i < size && i - end < MIN_GAP) {
+      if (a[i] != b[i]) {
+        end = i + 1;
+      }
+      i++;
+    }
+    utils::appendVarint(out, start - previousEnd);
+    utils::appendVarint(out, end - start);
+    for (size_t j = start; j < end; j++) {
+      out.push_back(a[j] ^ b[j]);
+    }
+    previousEnd = end;
+    i = end;
+  }
+}
+
+void Rewinder::applyDelta(const std::vector<uint8_t>& delta, uint8_t* state, size_t size) {
+  const uint8_t *data = delta.data();
+  const uint8_t *end = data + delta.size();
+  size_t offset = 0;
+  while (data < end) {
+    uint64_t gap, length;
+    if (!utils::readVarint(data, end, gap) || !utils::readVarint(data, end, length)
+        || gap > size - offset || length > size - offset - gap || length > (uint64_t)(end - data)) {
+      throw std::runtime_error("rewind delta does not match the state size");
+    }
+    offset += gap;
+    for (size_t j = 0; j < length; j++) {
+      state[offset++] ^= *data++;
+    }
+  }
+}
@@ -1,11 +1,17 @@
 #include "classic_interface.h"
 
+#include <fstream>
 #include <iostream>
 
 #include "controller.h"
+#include "profiler.h"
 
 
-constexpr Color ClassicInterface::palette[64];
+const int ClassicInterface::KEY_CODES[KEY_COUNT] = {
+  GLFW_KEY_A, GLFW_KEY_B, GLFW_KEY_LEFT_SHIFT, GLFW_KEY_SPACE,
+  GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_LEFT, GLFW_KEY_RIGHT,
+  GLFW_KEY_R, GLFW_KEY_BACKSPACE,
+};
 
 // XXX: this is a little weird, but lets us package our shaders in a more
 // convenient way (no need to manually copy files and open them after as they
@@ -22,43 +28,32 @@ const std::string ClassicInterface::vertexShaderSource =
 
 ClassicInterface::ClassicInterface():
   log(Logger::getLogger("ClassicInterface")),
-  quad{
-    0.0f, 0.0f, // top left
-    adaptWidth(ZOOM_FACTOR), 0.0f, // top right
-    0.0f, -adaptHeight(ZOOM_FACTOR), // bottom left
-
-    adaptWidth(ZOOM_FACTOR), 0.0f, // top right
-    0.0f, -adaptHeight(ZOOM_FACTOR), // bottom left
-    adaptWidth(ZOOM_FACTOR), -adaptHeight(ZOOM_FACTOR) // bottom right
-  },
+  frame(&frames.writeBuffer()),
+  running(true),
+  keys(0),
   timeStamp(std::chrono::high_resolution_clock::now())
 {
   initWindow();
   initShaderProgram();
-  initGrid();
-  initColor();
+  initTexture();
   initVAO();
   log.setLevel(DEBUG);
   frameCounter = 0;
+  profileKeyDown = false;
+  timerKeyDown = false;
+  speedKeyDown = false;
+  // the context can only be current on one thread at a time
+  glfwMakeContextCurrent(NULL);
+  renderThread = std::thread(&ClassicInterface::renderLoop, this);
 }
 
 ClassicInterface::~ClassicInterface() {
+  running = false;
+  renderThread.join();
+  std::ofstream summary(utils::FRAME_TIMES_FILE);
+  frameTimer.writeSummary(summary);
+  pacer.writeStats(summary);
   glfwTerminate();
-  delete colors;
-  delete offsets;
-}
-
-// Normalizes the [0, ZOOM_FACTOR * WIDTH] on the [0, 2] scale (which means that
-// it will return correct size for the screen. However, the position requires a
-// -1 to correct it).
-float ClassicInterface::adaptWidth(int value) {
-  float divisor = (float) 2 / (IOInterface::WIDTH * ZOOM_FACTOR);
-  return (float) value * divisor;
-}
-
-float ClassicInterface::adaptHeight(int value) {
-  float divisor = (float) 2 / (IOInterface::HEIGHT * ZOOM_FACTOR);
-  return (float) value * divisor;
 }
 
 // Performs GLFW related initialization and spins up the window environment.
@@ -86,11 +81,23 @@ void ClassicInterface::initWindow() {
   glViewport(0, 0, width, height);
 }
 
+// The palette never changes, and is set once and for all
 void ClassicInterface::initShaderProgram() {
   shaderProgram.compileAndLink(
     ClassicInterface::vertexShaderSource.c_str(),
     ClassicInterface::fragmentShaderSource.c_str()
   );
+  float colors[64 * 3];
+  for (int i = 0; i < 64; i++) {
+    Color color(IOInterface::PALETTE[i]);
+    colors[3 * i] = color.r;
+    colors[3 * i + 1] = color.g;
+    colors[3 * i + 2] = color.b;
+  }
+  shaderProgram.use();
+  shaderProgram.setVec3Array("palette", colors, 64);
+  shaderProgram.setInt("screen", 0);
+  shaderProgram.setInt("emphasis", 0);
 }
 
 bool ClassicInterface::shouldClose() { return window == NULL || glfwWindowShouldClose(window); }
@@ -100,130 +107,180 @@ void ClassicInterface::calculateFPS() {
   frameCounter++;
   auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - timeStamp);
   if (duration.count() > 1000) {
-    log.debug() << "FPS: " << frameCounter << "\n";
+    LOG_DEBUG(log) << LOG_LITERAL("FPS: ") << frameCounter << LOG_LITERAL("\n");
     frameCounter = 0;
     timeStamp = now;
   }
 }
-// Handles rendering logic, namely:
-//  1. Clear up the screen
-//  2. Load new color data (as only this can be changed)
-//  3. Draw instances
-//  4. Handle events
+// Handles the end of a frame, namely:
+//  1. Publish the frame to the render thread, and start filling the next one
+//  2. Handle events, and take a snapshot of the keys
+//  3. Wait until the next frame is due (see utils::FramePacer)
 void ClassicInterface::render() {
-  glClearColor(1.0f, 0.0f, 0.1f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  {
+    // the wait below is idle time, not rendering
+    PROFILE_SCOPE(RENDER_ZONE);
+    frameTimer.startPhase(utils::PRESENT_PHASE);
+    const Frame& published = *frame;
+    frames.publish();
+    // the new back buffer holds an older frame: start from the one just
+    // published, so that pixels the PPU does not draw (when rendering is
+    // disabled) do not flicker between two stale frames
+    frame = &frames.writeBuffer();
+    *frame = published;
+    calculateFPS();
+
+    frameTimer.startPhase(utils::INPUT_PHASE);
+    glfwPollEvents();
+    processInput();
+    sampleKeys();
+  }
 
-  int tileCount = IOInterface::WIDTH * IOInterface::HEIGHT;
-  glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
-  glBufferSubData(GL_ARRAY_BUFFER, 0, 3 * sizeof(float) * tileCount, colors);
+  frameTimer.startPhase(utils::IDLE_PHASE);
+  pacer.wait();
+  frameTimer.endFrame();
+}
+
+// The render thread only draws when there is a new frame, and waits for the
+// next vsync after each of them
+void ClassicInterface::renderLoop() {
+  glfwMakeContextCurrent(window);
+  glfwSwapInterval(1);
+  while (running) {
+    if (!frames.update()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    draw(frames.readBuffer());
+    glfwSwapBuffers(window);
+  }
+  glfwMakeContextCurrent(NULL);
+}
+
+// draw uploads the palette indexes of the frame (one byte per pixel), then
+// draws a quad covering the window, the fragment shader looking up the color
+// of each pixel (so that scaling is done by the GPU)
+void ClassicInterface::draw(const Frame& f) {
+  glBindTexture(GL_TEXTURE_2D, screenTexture);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, IOInterface::WIDTH, IOInterface::HEIGHT,
+    GL_RED_INTEGER, GL_UNSIGNED_BYTE, f.pixels);
 
   shaderProgram.use();
+  shaderProgram.setInt("emphasis", f.emphasis);
   glBindVertexArray(VAO);
-  glDrawArraysInstanced(GL_TRIANGLES, 0, 6, IOInterface::WIDTH * IOInterface::HEIGHT);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
   glBindVertexArray(0);
-  calculateFPS();
+}
 
-  processInput();
-  glfwSwapBuffers(window);
-  glfwPollEvents();
+void ClassicInterface::sampleKeys() {
+  uint32_t pressed = 0;
+  for (int k = 0; k < KEY_COUNT; k++) {
+    if (glfwGetKey(window, KEY_CODES[k]) == GLFW_PRESS)
+      pressed |= 1 << k;
+  }
+  keys = pressed;
 }
 
 void ClassicInterface::processInput() {
   // exit window on escape
   if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
     glfwSetWindowShouldClose(window, true);
+#ifdef ASTEN_PROFILER
+  // dump the profile when P is pressed
+  bool profileKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+  if (profileKey && !profileKeyDown) {
+    utils::Profiler::get().printTable(std::cout);
+    utils::Profiler::get().writeTrace(utils::PROFILE_TRACE_FILE);
+  }
+  profileKeyDown = profileKey;
+#endif
+  // toggle frame timing when T is pressed
+  bool timerKey = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+  if (timerKey && !timerKeyDown) {
+    frameTimer.toggle();
+    log.info() << "frame timing " << (frameTimer.isEnabled() ? "on" : "off") << "\n";
+  }
+  timerKeyDown = timerKey;
+  // cycle through 1x, 2x, 4x and unthrottled when Tab is pressed
+  bool speedKey = glfwGetKey(window, GLFW_KEY_TAB) == GLFW_PRESS;
+  if (speedKey && !speedKeyDown) {
+    int speed = pacer.getSpeed() == 4 ? 0 : pacer.getSpeed() == 0 ? 1 : 2 * pacer.getSpeed();
+    pacer.setSpeed(speed);
+    if (speed == 0)
+      log.info() << "speed: unthrottled\n";
+    else
+      log.info() << "speed: " << speed << "x\n";
+  }
+  speedKeyDown = speedKey;
 }
 
 bool ClassicInterface::shouldReset() {
-  return glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+  return isPressed(RESET_KEY);
+}
+
+bool ClassicInterface::shouldRewind() {
+  return isPressed(REWIND_KEY);
 }
 
-// Fills up the buttons
+// Fills up the buttons from the latest snapshot of the keys
 std::array<ButtonSet, 2> ClassicInterface::getButtons() {
   std::array<ButtonSet, 2> buttons = {0};
-  buttons[0].A = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
-  buttons[0].B = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
-  buttons[0].SELECT = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS;
-  buttons[0].START = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
-  buttons[0].UP = glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS;
-  buttons[0].DOWN = glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS;
-  buttons[0].LEFT = glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS;
-  buttons[0].RIGHT = glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS;
+  buttons[0].A = isPressed(A_KEY);
+  buttons[0].B = isPressed(B_KEY);
+  buttons[0].SELECT = isPressed(SELECT_KEY);
+  buttons[0].START = isPressed(START_KEY);
+  buttons[0].UP = isPressed(UP_KEY);
+  buttons[0].DOWN = isPressed(DOWN_KEY);
+  buttons[0].LEFT = isPressed(LEFT_KEY);
+  buttons[0].RIGHT = isPressed(RIGHT_KEY);
   return buttons;
 }
 
-// Creates the offsets that will be used to render the NES tiles (basically
-// glorified pixels). Offsets are ordered LINE PER LINE, TOP TO BOTTOM and LEFT
-// TO RIGHT.
-void ClassicInterface::initGrid() {
-  offsets = new float[IOInterface::WIDTH * IOInterface::HEIGHT * 2];
-  int i = 0;
-  float xOffset, yOffset;
-  for (int y = 0; y < IOInterface::HEIGHT * ZOOM_FACTOR; y += ZOOM_FACTOR) {
-    for (int x = 0; x < IOInterface::WIDTH * ZOOM_FACTOR; x += ZOOM_FACTOR) {
-      // we fill it up line per line
-      xOffset = adaptWidth(x) - 1;
-      yOffset = -(adaptHeight(y) - 1);
-      offsets[i++] = xOffset;
-      offsets[i++] = yOffset;
-    }
-  }
+// X goes left to right, Y top to bottom
+void ClassicInterface::colorPixel(int x, int y, int paletteIndex) {
+  frame->pixels[y * IOInterface::WIDTH + x] = paletteIndex;
 }
 
-// The color array has to be adjusted with the offset array!
-void ClassicInterface::initColor() {
-  colors = new float[IOInterface::WIDTH * IOInterface::HEIGHT * 3];
-  bool isEven = false;
-  float color = 0.0;
-  float incrementC = (float) 1 / (IOInterface::WIDTH * IOInterface::HEIGHT);
-  for (int i = 0; i < IOInterface::WIDTH * IOInterface::HEIGHT * 3; i += 3) {
-    colors[i] = color;
-    colors[i + 1] = color;
-    colors[i + 2] = color;
-    isEven = !isEven;
-    color += incrementC;
-  }
+void ClassicInterface::setEmphasis(int e) {
+  frame->emphasis = e;
 }
 
-// X goes left to right, Y top to bottom
-void ClassicInterface::colorPixel(int x, int y, int paletteIndex) {
-  int index = (y * IOInterface::WIDTH + x) * 3;
-  Color color = palette[paletteIndex];
-  colors[index] = color.r; // red
-  colors[index + 1] = color.g; // green
-  colors[index + 2] = color.b; // blue
+// Creates the texture holding the palette index of each pixel. Integer
+// textures cannot be filtered, so the shader reads the texels directly.
+void ClassicInterface::initTexture() {
+  glGenTextures(1, &screenTexture);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, screenTexture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  // rows are one byte per pixel, and not aligned on 4 bytes in general
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, IOInterface::WIDTH, IOInterface::HEIGHT, 0,
+    GL_RED_INTEGER, GL_UNSIGNED_BYTE, NULL);
 }
 
 // Handles OpenGL related logic (creating, binding buffers and attribute
-// pointers).
+// pointers) for the quad covering the window. The first row of the texture is
+// the top of the screen.
 void ClassicInterface::initVAO() {
-  int tileCount = IOInterface::WIDTH * IOInterface::HEIGHT;
+  float quad[16] = {
+    // position, texture coordinates
+    -1.0f, 1.0f, 0.0f, 0.0f, // top left
+    -1.0f, -1.0f, 0.0f, 1.0f, // bottom left
+    1.0f, 1.0f, 1.0f, 0.0f, // top right
+    1.0f, -1.0f, 1.0f, 1.0f, // bottom right
+  };
   glGenVertexArrays(1, &VAO);
   glGenBuffers(1, &quadVBO);
-  glGenBuffers(1, &colorVBO);
-  glGenBuffers(1, &offsetVBO);
 
   glBindVertexArray(VAO);
   glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 12, quad, GL_STATIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
   glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-
-
-  glBindBuffer(GL_ARRAY_BUFFER, offsetVBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * tileCount * 2, offsets, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
   glEnableVertexAttribArray(1);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-
-  glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * tileCount * 3, colors, GL_DYNAMIC_DRAW);
-  glEnableVertexAttribArray(2);
-  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-
-
-  glVertexAttribDivisor(1, 1);
-  glVertexAttribDivisor(2, 1);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+  glBindVertexArray(0);
 }
-
-
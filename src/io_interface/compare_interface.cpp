@@ -1,42 +1,97 @@
 #include "compare_interface.h"
 
-#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
 
+#include "hash.h"
 #include "streams.h"
 
-std::runtime_error compareError() {
-  return std::runtime_error("comparison error");
-}
-
 CompareInterface::CompareInterface(InterfaceType t, std::string btnLogPath, std::string scrnLogPath):
+  log(Logger::getLogger("CompareInterface")),
   target(IOInterface::newIOInterface(t, "", "")),
-  btnStream(btnLogPath, utils::StreamMode::IN),
-  screenStream(scrnLogPath, utils::StreamMode::IN, IOInterface::WIDTH*IOInterface::HEIGHT),
-  remainingCount(0), currentButtons({0}), 
-  remainingRstCount(0), currentReset(false), isDone(false)
+  screenLog(nullptr), hashStream(nullptr),
+  actual(IOInterface::WIDTH*IOInterface::HEIGHT), cursor(nullptr), frameEnd(nullptr),
+  expected(nullptr), screenFrame(0),
+  frame(IOInterface::WIDTH*IOInterface::HEIGHT), frameNumber(0),
+  inputFrame(0), isDone(false)
 {
-  // Read everything from the button stream up front, then load the first button
-  // and first reset
-  btnStream.readAll(nextButtons, nextResets);
-  loadNextButtons();
-  loadNextReset();
+  if (utils::HashStream::isGoldenFile(scrnLogPath)) {
+    hashStream = new utils::HashStream(scrnLogPath, utils::StreamMode::IN, IOInterface::WIDTH*IOInterface::HEIGHT);
+  } else {
+    screenLog = new utils::ScreenPrefetcher(scrnLogPath, IOInterface::WIDTH*IOInterface::HEIGHT);
+    nextScreen();
+  }
+
+  // Read everything from the button stream up front
+  utils::BtnStream btnStream(btnLogPath, utils::StreamMode::IN);
+  movie = btnStream.readMovie();
+}
+
+CompareInterface::~CompareInterface() {
+  delete hashStream;
+  delete screenLog;
+  delete target;
 }
 
 bool CompareInterface::shouldClose() { return isDone; }
 
 bool CompareInterface::shouldReset() {
-  if (remainingRstCount == 0) {
-    loadNextReset();
-  }
-
-  remainingRstCount--;
-  return currentReset;
+  return movie.at(inputFrame).reset;
 }
 
+bool CompareInterface::shouldRewind() { return false; }
+
 void CompareInterface::render() {
+  if (hashStream != nullptr && !isDone) {
+    compareFrame();
+  }
   target->render();
 }
 
+// compareFrame compares the frame that was just drawn to the golden file, and
+// throws if they differ
+void CompareInterface::compareFrame() {
+  uint64_t expected;
+  const uint8_t *keyframe;
+  if (!hashStream->readFrame(expected, keyframe)) {
+    isDone = true;
+    return;
+  }
+  long number = frameNumber++;
+  if (utils::hash64(frame.data(), frame.size()) == expected) {
+    return;
+  }
+  std::ostringstream message;
+  message << "comparison error: frame " << number << " differs from the golden file";
+  if (keyframe != nullptr) {
+    writeDiff(keyframe);
+    message << " (see " << GOLDEN_DIFF_FILE << ")";
+  }
+  throw std::runtime_error(message.str());
+}
+
+// writeDiff writes the expected frame, the actual one and the pixels that
+// differ (in red, over a darkened expected frame) side by side
+void CompareInterface::writeDiff(const uint8_t *expected) {
+  std::ofstream out(GOLDEN_DIFF_FILE, std::ios::binary);
+  out << "P6\n" << 3 * IOInterface::WIDTH << " " << IOInterface::HEIGHT << "\n255\n";
+  for (int y = 0; y < IOInterface::HEIGHT; y++) {
+    for (int panel = 0; panel < 3; panel++) {
+      for (int x = 0; x < IOInterface::WIDTH; x++) {
+        int i = y * IOInterface::WIDTH + x;
+        uint32_t color = IOInterface::PALETTE[(panel == 1 ? frame[i] : expected[i]) & 0x3f];
+        if (panel == 2) {
+          color = expected[i] != frame[i] ? 0xff0000 : (color >> 2) & 0x3f3f3f;
+        }
+        char rgb[3] = {(char)(color >> 16), (char)(color >> 8), (char)color};
+        out.write(rgb, sizeof(rgb));
+      }
+    }
+  }
+}
+
 void CompareInterface::colorPixel(int x, int y, int palette) {
   // Due to how the ppu (calling colorPixel) cycles several times for each cpu
   // (calling shouldClose()) cycle, it is possible that we try to render a few
@@ -46,51 +101,70 @@ void CompareInterface::colorPixel(int x, int y, int palette) {
     return;
   }
 
-  uint8_t val = screenStream.read();
-  if (val == utils::SCREENSTREAM_END) {
-    isDone = true;
+  if (hashStream != nullptr) {
+    frame[y * IOInterface::WIDTH + x] = palette;
+    target->colorPixel(x, y, palette);
     return;
   }
-  if ((int)val != palette) {
-    // XXX: This simple equality test is fine for fully deterministic programs
-    // (i.e. tests) but will fail otherwise.
-    throw compareError();
-  }
+
+  *cursor++ = palette;
+  if (cursor == frameEnd)
+    compareScreen();
   target->colorPixel(x, y, palette);
 }
 
-std::array<ButtonSet, 2> CompareInterface::getButtons() {
-  if (remainingCount == 0) {
-    loadNextButtons();
+// compareScreen compares a whole frame of the screen log at once, and throws
+// with the first pixel that differs
+//
+// XXX: This simple equality test is fine for fully deterministic programs
+// (i.e. tests) but will fail otherwise.
+void CompareInterface::compareScreen() {
+  int size = frameEnd - actual.data();
+  if (std::memcmp(actual.data(), expected, size) != 0) {
+    int i = std::mismatch(actual.begin(), actual.begin() + size, expected).first - actual.begin();
+    std::ostringstream message;
+    message << "comparison error: frame " << screenFrame << " differs from the screen log at x="
+      << i % IOInterface::WIDTH << ", y=" << i / IOInterface::WIDTH
+      << " (expected " << (int)expected[i] << ", got " << (int)actual[i] << ")";
+    throw std::runtime_error(message.str());
   }
-  remainingCount--;
-  return currentButtons;
-}
-
-// loadNextButtons will charge the next buttonset in the queue
-void CompareInterface::loadNextButtons() {
-  if (nextButtons.empty()) {
+  screenFrame++;
+  // a frame that is not complete is the last one
+  if (size < (int)actual.size()) {
+    isDone = true;
     return;
   }
-
-  auto next = nextButtons.front();
-  nextButtons.pop();
-  std::cout << "loading: " << next;
-  // TODO: handle second button
-  remainingCount = currentButtons[0].unmarshal(next);
+  nextScreen();
 }
 
-// loadNextReset will charge the next reset in the queue
-void CompareInterface::loadNextReset() {
-  if (nextResets.empty()) {
-    return;
-  }
+// nextScreen waits for the next frame of the screen log
+void CompareInterface::nextScreen() {
+  int size;
+  expected = screenLog->next(size);
+  if (size == 0)
+    isDone = true;
+  cursor = actual.data();
+  frameEnd = cursor + size;
+}
 
-  auto next = nextResets.front();
-  nextResets.pop();
-  std::cout << "loading: " << next;
-  remainingRstCount = next.count;
-  currentReset = next.reset;
+void CompareInterface::setEmphasis(int emphasis) {
+  target->setEmphasis(emphasis);
+}
 
+// setRomHash fails if the logs were recorded with another ROM (logs written
+// before the hash was recorded have none)
+void CompareInterface::setRomHash(uint32_t hash) {
+  uint32_t recorded = hashStream != nullptr ? hashStream->getRomHash() : screenLog->getRomHash();
+  if (recorded != 0 && recorded != hash)
+    throw std::runtime_error("the screen log was recorded with another ROM");
+  if (movie.romHash != 0 && movie.romHash != hash)
+    throw std::runtime_error("the button log was recorded with another ROM");
+  target->setRomHash(hash);
 }
 
+// getButtons moves on to the next frame: the console calls it after
+// shouldReset, once per frame
+std::array<ButtonSet, 2> CompareInterface::getButtons() {
+  utils::FrameInput input = movie.at(inputFrame++);
+  return {ButtonSet::decode(input.buttons[0]), ButtonSet::decode(input.buttons[1])};
+}
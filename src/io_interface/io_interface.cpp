@@ -3,6 +3,18 @@
 #include "spy_interface.h"
 #include "replay_interface.h"
 #include "compare_interface.h"
+#include "playback_interface.h"
+
+const uint32_t IOInterface::PALETTE[64] = {
+  0x666666, 0x002A88, 0x1412A7, 0x3B00A4, 0x5C007E, 0x6E0040, 0x6C0600, 0x561D00,
+  0x333500, 0x0B4800, 0x005200, 0x004F08, 0x00404D, 0x000000, 0x000000, 0x000000,
+  0xADADAD, 0x155FD9, 0x4240FF, 0x7527FE, 0xA01ACC, 0xB71E7B, 0xB53120, 0x994E00,
+  0x6B6D00, 0x388700, 0x0C9300, 0x008F32, 0x007C8D, 0x000000, 0x000000, 0x000000,
+  0xFFFEFF, 0x64B0FF, 0x9290FF, 0xC676FF, 0xF36AFF, 0xFE6ECC, 0xFE8170, 0xEA9E22,
+  0xBCBE00, 0x88D800, 0x5CE430, 0x45E082, 0x48CDDE, 0x4F4F4F, 0x000000, 0x000000,
+  0xFFFEFF, 0xC0DFFF, 0xD3D2FF, 0xE8C8FF, 0xFBC2FF, 0xFEC4EA, 0xFECCC5, 0xF7D8A5,
+  0xE4E594, 0xCFEF96, 0xBDF4AB, 0xB3F3CC, 0xB5EBF2, 0xB8B8B8, 0x000000, 0x000000,
+};
 
 IOInterface* IOInterface::newIOInterface(InterfaceType type, std::string btnLogPath, std::string scrnLogPath) {
   switch (type) {
@@ -16,6 +28,8 @@ IOInterface* IOInterface::newIOInterface(InterfaceType type, std::string btnLogP
       return new ReplayInterface(InterfaceType::CLASSIC, btnLogPath, scrnLogPath);
     case DEBUG_INTERFACE:
       return new CompareInterface(InterfaceType::SINK, btnLogPath, scrnLogPath);
+    case PLAYBACK:
+      return new PlaybackInterface(btnLogPath, scrnLogPath);
   }
 }
 
@@ -24,7 +38,7 @@ utils::ButtonsBuffer ButtonSet::marshal(long count) {
     A, B, SELECT, START, UP, DOWN, LEFT, RIGHT,
   };
 
-  uint8_t encoded;
+  uint8_t encoded = 0;
   for (int i = 0; i < 7; i++) {
     encoded |= buttonsOrdered[i];
     encoded <<= 1;
@@ -51,6 +65,19 @@ long ButtonSet::unmarshal(utils::ButtonsBuffer& buf) {
   return buf.count;
 }
 
+uint8_t ButtonSet::encode() {
+  return marshal(0).buttons;
+}
+
+ButtonSet ButtonSet::decode(uint8_t buttons) {
+  utils::ButtonsBuffer buf;
+  buf.count = 0;
+  buf.buttons = buttons;
+  ButtonSet set;
+  set.unmarshal(buf);
+  return set;
+}
+
 bool ButtonSet::isEqual(ButtonSet bs) {
   return A == bs.A &&
     B == bs.B &&
@@ -0,0 +1,82 @@
+#include "playback_interface.h"
+
+#include "streams.h"
+
+PlaybackInterface::PlaybackInterface(std::string btnLogPath, std::string scrnLogPath):
+  screenStream(nullptr),
+  hashStream(nullptr),
+  inputFrame(0)
+{
+  if (btnLogPath != "") {
+    utils::BtnStream btnStream(btnLogPath, utils::StreamMode::IN);
+    movie = btnStream.readMovie();
+  }
+  bool isGolden = scrnLogPath.size() >= utils::GOLDEN_EXTENSION.size() &&
+    scrnLogPath.compare(
+      scrnLogPath.size() - utils::GOLDEN_EXTENSION.size(), std::string::npos, utils::GOLDEN_EXTENSION
+    ) == 0;
+  if (isGolden) {
+    frame.resize(IOInterface::WIDTH*IOInterface::HEIGHT);
+    hashStream = new utils::HashStream(
+      scrnLogPath,
+      utils::StreamMode::OUT,
+      IOInterface::WIDTH*IOInterface::HEIGHT,
+      utils::HashStream::DEFAULT_KEYFRAME_INTERVAL
+    );
+  } else if (scrnLogPath != "") {
+    screenStream = new utils::ScreenStream(
+      scrnLogPath,
+      utils::StreamMode::OUT,
+      IOInterface::WIDTH*IOInterface::HEIGHT
+    );
+  }
+}
+
+PlaybackInterface::~PlaybackInterface() {
+  if (screenStream != nullptr) {
+    screenStream->close();
+    delete screenStream;
+  }
+  if (hashStream != nullptr) {
+    hashStream->close();
+    delete hashStream;
+  }
+}
+
+bool PlaybackInterface::shouldClose() { return false; }
+
+bool PlaybackInterface::shouldReset() {
+  return movie.at(inputFrame).reset;
+}
+
+bool PlaybackInterface::shouldRewind() { return false; }
+
+void PlaybackInterface::render() {
+  if (hashStream != nullptr) {
+    hashStream->writeFrame(frame.data());
+  }
+}
+
+void PlaybackInterface::setRomHash(uint32_t hash) {
+  if (screenStream != nullptr)
+    screenStream->setRomHash(hash);
+  if (hashStream != nullptr)
+    hashStream->setRomHash(hash);
+}
+
+void PlaybackInterface::colorPixel(int x, int y, int palette) {
+  if (screenStream != nullptr) {
+    screenStream->write(palette);
+  }
+  if (hashStream != nullptr) {
+    frame[y * IOInterface::WIDTH + x] = palette;
+  }
+}
+
+// getButtons moves on to the next frame: the console calls it after
+// shouldReset, once per frame. Once the log is exhausted, the last buttons stay
+// pressed.
+std::array<ButtonSet, 2> PlaybackInterface::getButtons() {
+  utils::FrameInput input = movie.at(inputFrame++);
+  return {ButtonSet::decode(input.buttons[0]), ButtonSet::decode(input.buttons[1])};
+}
@@ -1,41 +1,159 @@
 #include "replay_interface.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "streams.h"
 
+constexpr double ReplayInterface::MIN_SPEED;
+constexpr double ReplayInterface::MAX_SPEED;
+
+namespace {
+// frames decoded ahead, enough for two renders at the highest speed
+const int PREFETCH_FRAMES = 2 * (int)ReplayInterface::MAX_SPEED;
+} // namespace
+
 ReplayInterface::ReplayInterface(InterfaceType t, std::string btnLogPath, std::string scrnLogPath):
+  log(Logger::getLogger("ReplayInterface")),
   target(IOInterface::newIOInterface(t, "", "")),
-  screenStream(scrnLogPath, utils::StreamMode::IN, IOInterface::WIDTH*IOInterface::HEIGHT),
-  isClose(false)
+  screenLog(scrnLogPath, IOInterface::WIDTH*IOInterface::HEIGHT, PREFETCH_FRAMES),
+  screen(IOInterface::WIDTH*IOInterface::HEIGHT),
+  frame(-1),
+  speed(1),
+  paused(false),
+  progress(0),
+  steps(0),
+  atEnd(false),
+  previousButtons()
 {}
 
+ReplayInterface::~ReplayInterface() { delete target; }
+
 bool ReplayInterface::shouldClose() {
-  return isClose;
+  return target->shouldClose();
 }
 
 bool ReplayInterface::shouldReset() { return false; }
 
+bool ReplayInterface::shouldRewind() { return false; }
+
+// render shows the frame of the log that is due, in place of the one the
+// emulation just drew
 void ReplayInterface::render() {
+  int frames = steps;
+  steps = 0;
+  // pending steps (a seek shows its frame) replace the move of this render
+  if (!paused && frames == 0) {
+    progress += speed;
+    frames += (int)progress;
+    progress -= (int)progress;
+  }
+  advance(frames);
+  for (int y = 0; y < IOInterface::HEIGHT; y++) {
+    for (int x = 0; x < IOInterface::WIDTH; x++)
+      target->colorPixel(x, y, screen[y * IOInterface::WIDTH + x]);
+  }
+  target->setEmphasis(0);
   target->render();
 }
 
-void ReplayInterface::colorPixel(int x, int y, int palette) {
-  // Due to how the ppu (calling colorPixel) cycles several times for each cpu
-  // (calling shouldClose()) cycle, it is possible that we try to render a few
-  // more pixels before realizing that in fact we should be done.
-  // Return straight away to avoid any problems.
-  if (isClose) {
-    return;
+// advance moves frames forward in the log. Only the last one is copied to the
+// screen, the others being skipped.
+void ReplayInterface::advance(int frames) {
+  const uint8_t *pixels = nullptr;
+  int size = 0;
+  for (int i = 0; i < frames && !atEnd; i++) {
+    int read;
+    const uint8_t *next = screenLog.next(read);
+    if (read == 0) {
+      atEnd = true;
+      paused = true;
+      log.info() << "end of the screen log, at frame " << frame << "\n";
+      break;
+    }
+    pixels = next;
+    size = read;
+    frame++;
   }
+  // a last frame that is not complete is drawn over the previous one
+  if (pixels != nullptr)
+    std::memcpy(screen.data(), pixels, size);
+}
 
-  uint8_t val = screenStream.read();
-  if (val == utils::SCREENSTREAM_END) {
-    isClose = true;
-    return;
-  }
+// The emulation does not show anything, only the log does
+void ReplayInterface::colorPixel(int, int, int) {}
+
+void ReplayInterface::setEmphasis(int) {}
 
-  target->colorPixel(x, y, (int)val);
+void ReplayInterface::setRomHash(uint32_t hash) {
+  target->setRomHash(hash);
 }
 
+// getButtons reads the controls of the replay: the emulation gets no input
 std::array<ButtonSet, 2> ReplayInterface::getButtons() {
-  return target->getButtons();
+  handleButtons(target->getButtons()[0]);
+  return std::array<ButtonSet, 2>();
+}
+
+void ReplayInterface::handleButtons(ButtonSet buttons) {
+  ButtonSet pressed = {
+    buttons.A && !previousButtons.A,
+    buttons.B && !previousButtons.B,
+    buttons.SELECT && !previousButtons.SELECT,
+    buttons.START && !previousButtons.START,
+    buttons.UP && !previousButtons.UP,
+    buttons.DOWN && !previousButtons.DOWN,
+    buttons.LEFT && !previousButtons.LEFT,
+    buttons.RIGHT && !previousButtons.RIGHT,
+  };
+  previousButtons = buttons;
+  try {
+    if (pressed.START)
+      setPaused(!paused);
+    if (pressed.RIGHT && paused)
+      step(1);
+    else if (pressed.RIGHT)
+      seek(std::min(frame + SKIP_FRAMES, getFrameCount()));
+    if (pressed.LEFT && paused)
+      step(-1);
+    else if (pressed.LEFT)
+      seek(std::max(frame - SKIP_FRAMES, 0L));
+    if (pressed.UP)
+      setSpeed(2 * speed);
+    if (pressed.DOWN)
+      setSpeed(speed / 2);
+    if (pressed.SELECT)
+      seek(0);
+  } catch (const std::runtime_error& e) {
+    // seeking a v1 log, or past its end
+    log.warn() << e.what() << "\n";
+  }
+}
+
+void ReplayInterface::seek(long number) {
+  screenLog.seek(number);
+  frame = number - 1;
+  atEnd = false;
+  progress = 0;
+  // show it on the next render, even if paused
+  steps = 1;
+}
+
+void ReplayInterface::setSpeed(double s) {
+  speed = std::min(std::max(s, MIN_SPEED), MAX_SPEED);
+  log.info() << "replay speed: " << speed << "x\n";
+}
+
+void ReplayInterface::setPaused(bool p) {
+  paused = p;
+  progress = 0;
+}
+
+void ReplayInterface::step(int frames) {
+  if (!paused)
+    return;
+  if (frames >= 0)
+    steps += frames;
+  else
+    seek(std::max(frame + frames, 0L));
 }
@@ -54,3 +54,7 @@ void ShaderProgram::setBool(const std::string& name, bool value) const {
 void ShaderProgram::setFloat(const std::string& name, float value) const {
     glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
 }
+
+void ShaderProgram::setVec3Array(const std::string& name, const float *values, int count) const {
+    glUniform3fv(glGetUniformLocation(ID, name.c_str()), count, values);
+}
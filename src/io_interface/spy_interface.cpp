@@ -1,92 +1,72 @@
 #include "spy_interface.h"
 
-#include <iostream>
-
 #include "streams.h"
 
 
-SpyInterface::SpyInterface(InterfaceType t, std::string btnLogPath, std::string scrnLogPath):
+SpyInterface::SpyInterface(
+  InterfaceType t,
+  std::string btnLogPath,
+  std::string scrnLogPath,
+  utils::RecorderPolicy policy
+):
+  log(Logger::getLogger("SpyInterface")),
   target(IOInterface::newIOInterface(t, "", "")),
-  screenStream(scrnLogPath, utils::StreamMode::OUT, IOInterface::WIDTH*IOInterface::HEIGHT), 
+  screenRecorder(scrnLogPath, IOInterface::WIDTH*IOInterface::HEIGHT, policy),
   btnStream(btnLogPath, utils::StreamMode::OUT),
-  identicalCount(0), currentButtons({0}), 
-  identicalRstCount(0), currentReset(false)
+  currentReset(false)
 {}
 
+SpyInterface::~SpyInterface() { delete target; }
+
 bool SpyInterface::shouldClose() { 
   bool willClose = target->shouldClose();
   if (willClose) {
-    // onClose, we want to write any leftover and close files to make sure the
-    // streams are flushed
-    writeCurrentButtons();
-    writeCurrentReset();
+    // onClose, we want to close files to make sure the streams are flushed
     btnStream.close();
-    screenStream.close();
+    screenRecorder.close();
+    if (screenRecorder.getDroppedFrames() > 0)
+      log.warn() << screenRecorder.getDroppedFrames() << " frames were dropped from the screen log\n";
   }
 
   return willClose;
 }
 
 bool SpyInterface::shouldReset() {
-  bool reset = target->shouldReset();
-
-  if (reset == currentReset) {
-    // reset value did not change, increment counter
-    identicalRstCount++;
-    return currentReset;
-  }
-
-  // Write old buttons
-  writeCurrentReset();
-
-  // Reset
-  currentReset = reset;
-  identicalRstCount = 1;
-
+  currentReset = target->shouldReset();
   return currentReset;
 }
 
+// XXX: rewinding is forwarded so that it is available while monitoring, but
+// the resulting logs cannot be replayed
+bool SpyInterface::shouldRewind() { return target->shouldRewind(); }
+
 void SpyInterface::render() {
   target->render();
 }
 
 void SpyInterface::colorPixel(int x, int y, int palette) {
-  screenStream.write(palette);
+  screenRecorder.write(palette);
   target->colorPixel(x, y, palette);
 }
 
-std::array<ButtonSet, 2> SpyInterface::getButtons() {
-  auto buttons = target->getButtons();
-  if (
-    buttons[0].isEqual(currentButtons[0]) &&
-    buttons[1].isEqual(currentButtons[1])
-  ) {
-    // the buttons did not change, increment counter
-    identicalCount ++;
-    return currentButtons;
-  }
-
-  // Write old buttons
-  // TODO: support two button sets
-  writeCurrentButtons();
-
-  // Reset
-  currentButtons = buttons;
-  identicalCount = 1;
-  return buttons;
+void SpyInterface::setEmphasis(int emphasis) {
+  target->setEmphasis(emphasis);
 }
 
-void SpyInterface::writeCurrentButtons() {
-  utils::ButtonsBuffer encoded = currentButtons[0].marshal(identicalCount);
-  std::cout << encoded;
-  btnStream.write(encoded);
+void SpyInterface::setRomHash(uint32_t hash) {
+  screenRecorder.setRomHash(hash);
+  btnStream.setRomHash(hash);
+  target->setRomHash(hash);
 }
 
-void SpyInterface::writeCurrentReset() {
-  std::cout << currentReset;
-  utils::ResetBuffer encoded;
-  encoded.count = identicalRstCount;
-  encoded.reset = currentReset;
-  std::cout << encoded;
-  btnStream.write(encoded);
+// getButtons records the input of the frame: the console calls it after
+// shouldReset, once per frame
+std::array<ButtonSet, 2> SpyInterface::getButtons() {
+  auto buttons = target->getButtons();
+  utils::FrameInput input;
+  input.buttons[0] = buttons[0].encode();
+  input.buttons[1] = buttons[1].encode();
+  input.reset = currentReset;
+  btnStream.writeFrame(input);
+  return buttons;
 }
@@ -1,8 +1,29 @@
 R""(#version 330 core
-in vec4 vertexColor;
+in vec2 texCoord;
 
 out vec4 FragColor;
 
+// palette indexes of the screen, one per NES pixel
+uniform usampler2D screen;
+uniform vec3 palette[64];
+// red, green and blue emphasis bits of PPUMASK (bits 0, 1 and 2)
+uniform int emphasis;
+
+// emphasizing a color darkens the two others
+const float ATTENUATION = 0.75;
+
 void main() {
-    FragColor = vertexColor;
+    ivec2 size = textureSize(screen, 0);
+    ivec2 pixel = min(ivec2(texCoord * vec2(size)), size - 1);
+    uint index = texelFetch(screen, pixel, 0).r & 63u;
+    vec3 color = palette[index];
+    // blacks ($xE and $xF) are not affected
+    if ((index & 14u) != 14u) {
+        vec3 attenuation = vec3(1.0);
+        if ((emphasis & 1) != 0) attenuation *= vec3(1.0, ATTENUATION, ATTENUATION);
+        if ((emphasis & 2) != 0) attenuation *= vec3(ATTENUATION, 1.0, ATTENUATION);
+        if ((emphasis & 4) != 0) attenuation *= vec3(ATTENUATION, ATTENUATION, 1.0);
+        color *= attenuation;
+    }
+    FragColor = vec4(color, 1.0);
 })""
@@ -1,12 +1,11 @@
 R""(#version 330 core
 
 layout (location = 0) in vec2 aPos;
-layout (location = 1) in vec2 aOffset;
-layout (location = 2) in vec3 aColor;
+layout (location = 1) in vec2 aTexCoord;
 
-out vec4 vertexColor;
+out vec2 texCoord;
 
 void main() {
-    gl_Position = vec4(aPos + aOffset, 0.0, 1.0);
-    vertexColor = vec4(aColor, 1.0);
+    gl_Position = vec4(aPos, 0.0, 1.0);
+    texCoord = aTexCoord;
 })""
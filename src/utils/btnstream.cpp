@@ -1,39 +1,131 @@
 #include "btnstream.h"
+#include <cstring>
 #include <iostream>
 
+#include "varint.h"
+
 namespace utils {
-BtnStream::BtnStream(std::string fileName, StreamMode mode) {
+const char BtnStream::MOVIE_SIGNATURE[SIG_SIZE] = {'M', 'O', 'V'};
+
+BtnStream::BtnStream(std::string name, StreamMode mode):
+  file(NULL), fileName(name), romHash(0), runInput(), runLength(0), cursor(NULL)
+{
   switch (mode) {
     case StreamMode::IN:
-      stream.open(fileName, std::ios::binary | std::ios::in);
+      file = new MappedFile(fileName);
+      cursor = file->data();
       break;
-    case StreamMode::OUT:
+    case StreamMode::OUT: {
       stream.open(fileName, std::ios::binary | std::ios::out);
+      uint8_t version = 2;
+      stream.write(MOVIE_SIGNATURE, sizeof(MOVIE_SIGNATURE));
+      stream.write((char*)&version, sizeof(version));
+      stream.write((char*)&romHash, sizeof(romHash));
       break;
+    }
   }
 }
 
-void BtnStream::write(ButtonsBuffer& buf) {
-  stream.write((char*)&btnSignature, sizeof(btnSignature));
-  stream.write((char*)&buf.count, sizeof(buf.count));
-  stream.write((char*)&buf.buttons, sizeof(buf.buttons));
+BtnStream::~BtnStream() {
+  delete file;
 }
 
-void BtnStream::write(ResetBuffer& buf) {
-  stream.write((char*)&rstSignature, sizeof(rstSignature));
-  stream.write((char*)&buf.count, sizeof(buf.count));
-  stream.write((char*)&buf.reset, sizeof(buf.reset));
+void BtnStream::writeFrame(const FrameInput& input) {
+  if (runLength > 0 && !(input == runInput)) {
+    writeRun();
+  }
+  runInput = input;
+  runLength++;
+}
+
+void BtnStream::writeRun() {
+  std::string record;
+  appendVarint(record, runLength);
+  record.push_back(runInput.buttons[0]);
+  record.push_back(runInput.buttons[1]);
+  record.push_back(runInput.reset);
+  stream.write(record.data(), record.size());
+  runLength = 0;
 }
 
 void BtnStream::close() {
-  stream.write((char*)&endSignature, sizeof(endSignature));
+  if (runLength > 0) {
+    writeRun();
+  }
+  uint8_t end = 0;
+  stream.write((char*)&end, sizeof(end));
+  // the hash is usually only known once the stream was opened
+  stream.seekp(ROM_HASH_OFFSET);
+  stream.write((char*)&romHash, sizeof(romHash));
   stream.close();
 }
 
+Movie BtnStream::readMovie() {
+  if (file->size() < (size_t)SIG_SIZE || std::memcmp(file->data(), MOVIE_SIGNATURE, SIG_SIZE) != 0) {
+    return readV1();
+  }
+  uint8_t version;
+  Movie movie;
+  cursor = file->data() + SIG_SIZE;
+  take(&version, sizeof(version));
+  if (version != 2)
+    throw std::runtime_error(fileName + " was written by another version of asten");
+  take(&movie.romHash, sizeof(movie.romHash));
+  while (true) {
+    uint64_t length = takeVarint();
+    if (length == 0)
+      break;
+    FrameInput input;
+    uint8_t reset;
+    take(input.buttons, sizeof(input.buttons));
+    take(&reset, sizeof(reset));
+    input.reset = reset != 0;
+    appendRun(movie, input, length);
+  }
+  return movie;
+}
+
+// readV1 merges the button and reset records of a v1 log, frame by frame
+Movie BtnStream::readV1() {
+  std::queue<ButtonsBuffer> buttons;
+  std::queue<ResetBuffer> resets;
+  readAll(buttons, resets);
+  Movie movie;
+  FrameInput input = FrameInput();
+  long buttonsLeft = 0, resetsLeft = 0;
+  while (!buttons.empty() || !resets.empty() || buttonsLeft > 0 || resetsLeft > 0) {
+    // the shortest of the current runs decides how long input stays the same
+    if (buttonsLeft == 0 && !buttons.empty()) {
+      input.buttons[0] = buttons.front().buttons;
+      buttonsLeft = buttons.front().count;
+      buttons.pop();
+    }
+    if (resetsLeft == 0) {
+      // the reset button is released once its records are over
+      input.reset = !resets.empty() && resets.front().reset;
+      if (!resets.empty()) {
+        resetsLeft = resets.front().count;
+        resets.pop();
+      }
+    }
+    long count = buttonsLeft;
+    if (count == 0 || (resetsLeft > 0 && resetsLeft < count))
+      count = resetsLeft;
+    if (count <= 0) {
+      // empty runs
+      continue;
+    }
+    appendRun(movie, input, count);
+    buttonsLeft -= buttonsLeft > 0 ? count : 0;
+    resetsLeft -= resetsLeft > 0 ? count : 0;
+  }
+  return movie;
+}
+
 void BtnStream::readAll(std::queue<ButtonsBuffer>& buttons, std::queue<ResetBuffer>& resets) {
   while (true) {
     char signature[SIG_SIZE];
-    stream.read((char*)&signature, sizeof(signature));
+    take(&signature, sizeof(signature));
     bool isBtn = true;
     bool isRst = true;
     bool isEnd = true;
@@ -70,16 +162,42 @@ void BtnStream::readAll(std::queue<ButtonsBuffer>& buttons, std::queue<ResetBuff
 
 void BtnStream::read(std::queue<ButtonsBuffer>& buttons) {
   ButtonsBuffer buf;
-  stream.read((char*)&buf.count, sizeof(buf.count));
-  stream.read((char*)&buf.buttons, sizeof(buf.buttons));
+  take(&buf.count, sizeof(buf.count));
+  take(&buf.buttons, sizeof(buf.buttons));
+  if (buf.count < 0)
+    throw std::runtime_error(fileName + " is corrupted");
   buttons.push(buf);
 }
 
 void BtnStream::read(std::queue<ResetBuffer>& resets) {
   ResetBuffer buf;
-  stream.read((char*)&buf.count, sizeof(buf.count));
-  stream.read((char*)&buf.reset, sizeof(buf.reset));
+  take(&buf.count, sizeof(buf.count));
+  take(&buf.reset, sizeof(buf.reset));
+  if (buf.count < 0)
+    throw std::runtime_error(fileName + " is corrupted");
   resets.push(buf);
 }
 
+// appendRun adds length frames of input to movie, refusing lengths that only a
+// corrupted log would hold (they would take gigabytes)
+void BtnStream::appendRun(Movie& movie, const FrameInput& input, uint64_t length) {
+  if (length > (uint64_t)(MAX_FRAMES - movie.size()))
+    throw std::runtime_error(fileName + " is corrupted");
+  movie.append(input, length);
+}
+
+uint64_t BtnStream::takeVarint() {
+  uint64_t value;
+  if (!readVarint(cursor, file->end(), value))
+    throw std::runtime_error(fileName + " is corrupted");
+  return value;
+}
+
+void BtnStream::take(void *out, size_t size) {
+  if ((size_t)(file->end() - cursor) < size)
+    throw std::runtime_error(fileName + " is truncated");
+  std::memcpy(out, cursor, size);
+  cursor += size;
+}
+
 } // namespace utils
@@ -1,5 +1,12 @@
 #include "byte_aggregator.h"
 
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace utils {
 std::ostream& operator<< (std::ostream& out, AggrBytes& ab) {
   if (ab.is8) {
@@ -35,6 +42,70 @@ std::istream& operator>> (std::istream& in, AggrBytes& ab) {
   return in;
 }
 
+void appendAggrBytes(std::string& out, const AggrBytes& ab) {
+  if (ab.is8) {
+    out.push_back(ab.val);
+    out.push_back(ab.count & 0xff);
+    return;
+  }
+  out.push_back(ab.val | 0x80);
+  out.push_back(ab.count & 0xff);
+  out.push_back(ab.count >> 8);
+}
+
+size_t findRunEnd(const uint8_t *bytes, size_t start, size_t size) {
+  uint8_t value = bytes[start];
+  size_t i = start + 1;
+#ifdef __SSE2__
+  __m128i values = _mm_set1_epi8(value);
+  for (; i + 16 <= size; i += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i*)(bytes + i));
+    // one bit per byte that differs
+    unsigned differs = ~_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, values)) & 0xffff;
+    if (differs != 0)
+      return i + __builtin_ctz(differs);
+  }
+#endif
+  while (i < size && bytes[i] == value)
+    i++;
+  return i;
+}
+
+size_t decodeAggrBytes(const uint8_t *&data, const uint8_t *end, AggrBytes& run, uint8_t *out, size_t size) {
+  size_t filled = 0;
+  while (filled < size) {
+    if (run.count == 0) {
+      if (data == end || *data == 0xff)
+        break;
+      // the msb of the value tells whether count is on one byte or two
+      uint8_t byte = *data++;
+      int countSize = byte >> 7 == 0 ? 1 : 2;
+      if (end - data < countSize)
+        throw std::runtime_error("truncated run");
+      run.val = byte & 0x7f;
+      run.is8 = countSize == 1;
+      run.count = countSize == 1 ? data[0] : data[0] | data[1] << 8;
+      data += countSize;
+      continue;
+    }
+    size_t count = std::min((size_t)run.count, size - filled);
+#ifdef __SSE2__
+    // most runs are short: storing 16 bytes (the ones past the run being
+    // overwritten by the next ones) is cheaper than calling memset
+    if (count <= 16 && size - filled >= 16) {
+      _mm_storeu_si128((__m128i*)(out + filled), _mm_set1_epi8(run.val));
+      filled += count;
+      run.count -= count;
+      continue;
+    }
+#endif
+    std::memset(out + filled, run.val, count);
+    filled += count;
+    run.count -= count;
+  }
+  return filled;
+}
+
 ByteAggregator::ByteAggregator(int capacity): locked(false) {}
 
 void ByteAggregator::load(uint8_t byte) {
@@ -62,6 +133,33 @@ void ByteAggregator::load(uint8_t byte) {
   aggr.count++;
 }
 
+// loadAll goes through the input run by run rather than byte by byte: as all
+// the bytes of a run are equal, checking its value checks all of them
+void ByteAggregator::loadAll(const uint8_t *bytes, size_t size, std::string& out) {
+  size_t i = 0;
+  while (i < size) {
+    uint8_t byte = bytes[i];
+    if (byte >= ByteAggregator::MAX) {
+      throw std::runtime_error("writing a value too big to byteAggregator");
+    }
+    size_t runEnd = findRunEnd(bytes, i, size);
+    size_t left = runEnd - i;
+    while (left > 0) {
+      if (!canLoad(byte)) {
+        appendAggrBytes(out, aggr);
+        reset();
+      }
+      size_t count = std::min(left, (size_t)(ByteAggregator::CAP - aggr.count));
+      aggr.val = byte;
+      locked = true;
+      aggr.count += count;
+      aggr.is8 = aggr.count <= 0xff;
+      left -= count;
+    }
+    i = runEnd;
+  }
+}
+
 bool ByteAggregator::canLoad(uint8_t byte) {
   if (aggr.count == ByteAggregator::CAP) {
     return false;
@@ -0,0 +1,65 @@
+#include "cow_array.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace utils {
+const size_t CowArray::PAGE_SIZE;
+
+std::shared_ptr<uint8_t> newPage() {
+  return std::shared_ptr<uint8_t>(
+    new uint8_t[CowArray::PAGE_SIZE](),
+    std::default_delete<uint8_t[]>()
+  );
+}
+
+CowArray::CowArray(size_t size): bytes(size) {
+  size_t count = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+  for (size_t i = 0; i < count; i++) {
+    owners.push_back(newPage());
+    pages.push_back(owners.back().get());
+    owned.push_back(true);
+  }
+}
+
+CowArray::CowArray(CowArray& source):
+  bytes(source.bytes),
+  pages(source.pages),
+  owners(source.owners),
+  owned(source.owned.size(), false)
+{
+  std::fill(source.owned.begin(), source.owned.end(), false);
+}
+
+void CowArray::own(size_t page) {
+  // the page may not be shared anymore, if the other arrays were destroyed
+  // or have made their own copy
+  if (owners[page].use_count() > 1) {
+    std::shared_ptr<uint8_t> copy = newPage();
+    std::memcpy(copy.get(), pages[page], PAGE_SIZE);
+    owners[page] = copy;
+    pages[page] = copy.get();
+  }
+  owned[page] = true;
+}
+
+size_t CowArray::size() const { return bytes; }
+
+size_t CowArray::pageBytes(size_t page) const {
+  return std::min(PAGE_SIZE, bytes - page * PAGE_SIZE);
+}
+
+void CowArray::save(StateBuffer& state) const {
+  for (size_t i = 0; i < pages.size(); i++) {
+    state.write(pages[i], pageBytes(i));
+  }
+}
+
+void CowArray::load(StateBuffer& state) {
+  for (size_t i = 0; i < pages.size(); i++) {
+    if (!owned[i])
+      own(i);
+    state.read(pages[i], pageBytes(i));
+  }
+}
+} // namespace utils
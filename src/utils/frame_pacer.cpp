@@ -0,0 +1,48 @@
+#include "frame_pacer.h"
+
+#include <iomanip>
+#include <thread>
+
+namespace utils {
+const int FramePacer::SPIN_MICROSECONDS;
+const int FramePacer::RESYNC_MICROSECONDS;
+
+FramePacer::FramePacer(double r): frameRate(r), speed(1) {
+  resync(Clock::now());
+}
+
+void FramePacer::resync(Clock::time_point now) {
+  start = now;
+  frames = 0;
+}
+
+void FramePacer::setSpeed(int s) {
+  speed = s;
+  resync(Clock::now());
+}
+
+void FramePacer::wait() {
+  if (speed == 0)
+    return;
+  frames++;
+  Clock::time_point deadline = start + std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<double>(frames / (frameRate * speed)));
+  Clock::time_point now = Clock::now();
+  if (now > deadline + std::chrono::microseconds(RESYNC_MICROSECONDS)) {
+    resync(now);
+    return;
+  }
+  Clock::time_point wakeUp = deadline - std::chrono::microseconds(SPIN_MICROSECONDS);
+  if (now < wakeUp)
+    std::this_thread::sleep_until(wakeUp);
+  while ((now = Clock::now()) < deadline) {}
+  jitter.record(std::chrono::duration_cast<std::chrono::microseconds>(now - deadline).count());
+}
+
+void FramePacer::writeStats(std::ostream& out) {
+  out << "frame start jitter (us): p50 " << jitter.percentile(0.5)
+    << ", p99 " << jitter.percentile(0.99) << ", max " << jitter.max()
+    << " (" << jitter.count() << " frames)\n";
+}
+
+} // namespace utils
@@ -0,0 +1,171 @@
+#include "frame_timer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include "logger.h"
+#include "profiler.h"
+
+namespace utils {
+
+namespace {
+const char *PHASE_NAMES[PHASE_COUNT] = {
+  "emulate",
+  "present",
+  "input",
+  "idle",
+};
+// precision of the histogram: values are exact below 2 * HALF_BUCKETS
+const int HALF_BUCKETS = 32;
+const int HALF_BUCKETS_BITS = 5;
+
+int highestBit(uint64_t value) {
+  int bit = 0;
+  while (value >>= 1)
+    bit++;
+  return bit;
+}
+
+double milliseconds(uint64_t microseconds) {
+  return microseconds / 1000.0;
+}
+} // namespace
+
+Histogram::Histogram(): counts(2 * HALF_BUCKETS), total(0), maxValue(0) {}
+
+// Values below 2 * HALF_BUCKETS have a bucket of their own. Above, the
+// HALF_BUCKETS + 1 highest bits of the value select the bucket.
+size_t Histogram::bucketOf(uint64_t value) {
+  if (value < 2 * HALF_BUCKETS)
+    return value;
+  int shift = highestBit(value) - HALF_BUCKETS_BITS;
+  return 2 * HALF_BUCKETS + (shift - 1) * HALF_BUCKETS + ((value >> shift) - HALF_BUCKETS);
+}
+
+uint64_t Histogram::upperBound(size_t bucket) {
+  if (bucket < 2 * HALF_BUCKETS)
+    return bucket;
+  int shift = (bucket - 2 * HALF_BUCKETS) / HALF_BUCKETS + 1;
+  uint64_t high = (bucket - 2 * HALF_BUCKETS) % HALF_BUCKETS + HALF_BUCKETS;
+  return ((high + 1) << shift) - 1;
+}
+
+void Histogram::record(uint64_t value) {
+  size_t bucket = bucketOf(value);
+  if (bucket >= counts.size())
+    counts.resize(bucket + 1);
+  counts[bucket]++;
+  total++;
+  if (value > maxValue)
+    maxValue = value;
+}
+
+uint64_t Histogram::percentile(double p) const {
+  if (total == 0)
+    return 0;
+  uint64_t rank = std::ceil(p * total);
+  if (rank < 1)
+    rank = 1;
+  uint64_t seen = 0;
+  for (size_t b = 0; b < counts.size(); b++) {
+    seen += counts[b];
+    if (seen >= rank)
+      return std::min(upperBound(b), maxValue);
+  }
+  return maxValue;
+}
+
+FrameTimer::FrameTimer(uint64_t b):
+  budget(b), enabled(true), started(false), phase(EMULATE_PHASE),
+  current(), frameCount(0), slowFrameCount(0)
+{}
+
+void FrameTimer::toggle() {
+  enabled = !enabled;
+  // the frame in progress was only partly timed
+  started = false;
+}
+
+void FrameTimer::closePhase(Clock::time_point now) {
+  current[phase] += std::chrono::duration_cast<std::chrono::microseconds>(now - phaseStart).count();
+  phaseStart = now;
+}
+
+void FrameTimer::startPhase(FramePhase p) {
+  if (!enabled || !started)
+    return;
+  closePhase(Clock::now());
+  phase = p;
+}
+
+bool FrameTimer::endFrame() {
+  if (!enabled)
+    return false;
+  Clock::time_point now = Clock::now();
+  bool slow = false;
+  if (started) {
+    closePhase(now);
+    uint64_t duration = 0;
+    for (int p = 0; p < PHASE_COUNT; p++) {
+      phases[p].record(current[p]);
+      if (p != IDLE_PHASE)
+        duration += current[p];
+    }
+    frames.record(duration);
+    slow = duration > budget;
+    if (slow) {
+      std::string report = describeFrame(duration);
+      Logger::getLogger("FrameTimer").warn() << report;
+      slowFrameCount++;
+      if (slowFrames.size() == SLOW_FRAMES)
+        slowFrames.erase(slowFrames.begin());
+      slowFrames.push_back(report);
+    }
+    frameCount++;
+  }
+  started = true;
+  phase = EMULATE_PHASE;
+  phaseStart = now;
+  for (int p = 0; p < PHASE_COUNT; p++)
+    current[p] = 0;
+  return slow;
+}
+
+// describeFrame returns the breakdown of the current frame, including the time
+// spent in each zone of the profiler when it is built
+std::string FrameTimer::describeFrame(uint64_t duration) {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(2);
+  out << "slow frame " << frameCount << ": " << milliseconds(duration) << " ms (";
+  for (int p = 0; p < PHASE_COUNT; p++)
+    out << (p ? ", " : "") << PHASE_NAMES[p] << " " << milliseconds(current[p]);
+  out << ")\n";
+#ifdef ASTEN_PROFILER
+  Profiler::get().printCurrentFrame(out);
+#endif
+  return out.str();
+}
+
+void FrameTimer::writeSummary(std::ostream& out) {
+  out << "frames: " << frameCount << ", over " << milliseconds(budget) << " ms: " << slowFrameCount << "\n";
+  out << std::fixed << std::setprecision(2);
+  out << std::left << std::setw(10) << "ms" << std::right
+    << std::setw(10) << "p50" << std::setw(10) << "p95" << std::setw(10) << "p99"
+    << std::setw(10) << "max" << "\n";
+  for (int p = 0; p <= PHASE_COUNT; p++) {
+    const Histogram& h = p < PHASE_COUNT ? phases[p] : frames;
+    out << std::left << std::setw(10) << (p < PHASE_COUNT ? PHASE_NAMES[p] : "busy") << std::right
+      << std::setw(10) << milliseconds(h.percentile(0.5))
+      << std::setw(10) << milliseconds(h.percentile(0.95))
+      << std::setw(10) << milliseconds(h.percentile(0.99))
+      << std::setw(10) << milliseconds(h.max()) << "\n";
+  }
+  if (!slowFrames.empty())
+    out << "\nlatest slow frames\n";
+  for (auto& report: slowFrames)
+    out << report;
+}
+
+} // namespace utils
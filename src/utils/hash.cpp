@@ -0,0 +1,70 @@
+#include "hash.h"
+
+#include <cstring>
+
+namespace utils {
+namespace {
+struct Crc32Table {
+  uint32_t entries[256];
+  Crc32Table() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int bit = 0; bit < 8; bit++)
+        c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      entries[i] = c;
+    }
+  }
+};
+const Crc32Table table;
+
+const uint64_t PRIME1 = 0x9e3779b185ebca87ULL;
+const uint64_t PRIME2 = 0xc2b2ae3d27d4eb4fULL;
+const uint64_t PRIME3 = 0x165667b19e3779f9ULL;
+const uint64_t PRIME4 = 0x85ebca77c2b2ae63ULL;
+
+inline uint64_t rotate(uint64_t x, int bits) {
+  return (x << bits) | (x >> (64 - bits));
+}
+
+inline uint64_t mixLane(uint64_t lane, uint64_t word) {
+  return rotate(lane + word * PRIME2, 31) * PRIME1;
+}
+} // namespace
+
+uint32_t crc32(const uint8_t *data, size_t size) {
+  uint32_t c = 0xffffffff;
+  for (size_t i = 0; i < size; i++)
+    c = table.entries[(c ^ data[i]) & 0xff] ^ (c >> 8);
+  return c ^ 0xffffffff;
+}
+
+uint64_t hash64(const uint8_t *data, size_t size) {
+  // four independent lanes, so that the multiplications overlap
+  uint64_t lanes[4] = {PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1};
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    uint64_t words[4];
+    std::memcpy(words, data + i, sizeof(words));
+    for (int l = 0; l < 4; l++)
+      lanes[l] = mixLane(lanes[l], words[l]);
+  }
+  uint64_t h = rotate(lanes[0], 1) + rotate(lanes[1], 7) + rotate(lanes[2], 12) + rotate(lanes[3], 18);
+  for (int l = 0; l < 4; l++)
+    h = (h ^ mixLane(0, lanes[l])) * PRIME1 + PRIME4;
+  h += size;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    h = rotate(h ^ mixLane(0, word), 27) * PRIME1 + PRIME4;
+  }
+  for (; i < size; i++)
+    h = rotate(h ^ (data[i] * PRIME3), 11) * PRIME1;
+  // avalanche, so that every bit of input affects every bit of output
+  h ^= h >> 33;
+  h *= PRIME2;
+  h ^= h >> 29;
+  h *= PRIME3;
+  h ^= h >> 32;
+  return h;
+}
+} // namespace utils
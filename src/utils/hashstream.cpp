@@ -0,0 +1,87 @@
+#include "hashstream.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "hash.h"
+
+namespace utils {
+const char HashStream::SIGNATURE[3] = {'H', 'S', 'H'};
+
+HashStream::HashStream(std::string name, StreamMode mode, int size, int interval):
+  file(NULL),
+  fileName(name),
+  screenSize(size),
+  keyframeInterval(interval),
+  romHash(0),
+  frameCount(0),
+  cursor(NULL)
+{
+  switch (mode) {
+    case StreamMode::IN: {
+      file = new MappedFile(fileName);
+      const uint8_t *data = file->data();
+      if (!isGoldenFile(fileName) || file->size() < (size_t)HEADER_SIZE || data[sizeof(SIGNATURE)] != 1)
+        throw std::runtime_error(fileName + " is not a golden file");
+      uint32_t header[3];
+      std::memcpy(header, data + sizeof(SIGNATURE) + 1, sizeof(header));
+      if ((int)header[0] != screenSize)
+        throw std::runtime_error(fileName + " was written for another screen size");
+      keyframeInterval = header[1];
+      romHash = header[2];
+      cursor = data + HEADER_SIZE;
+      break;
+    }
+    case StreamMode::OUT: {
+      if (keyframeInterval < 0)
+        throw std::runtime_error("the keyframe interval cannot be negative");
+      stream.open(fileName, std::ios::binary | std::ios::out);
+      uint8_t version = 1;
+      uint32_t header[] = {(uint32_t)screenSize, (uint32_t)keyframeInterval, romHash};
+      stream.write(SIGNATURE, sizeof(SIGNATURE));
+      stream.write((char*)&version, sizeof(version));
+      stream.write((char*)header, sizeof(header));
+      break;
+    }
+  }
+}
+
+HashStream::~HashStream() {
+  delete file;
+}
+
+bool HashStream::isGoldenFile(std::string fileName) {
+  std::ifstream in(fileName, std::ios::binary);
+  char signature[sizeof(SIGNATURE)];
+  return in.read(signature, sizeof(signature)) && std::memcmp(signature, SIGNATURE, sizeof(SIGNATURE)) == 0;
+}
+
+void HashStream::writeFrame(const uint8_t *pixels) {
+  uint64_t hash = hash64(pixels, screenSize);
+  stream.write((char*)&hash, sizeof(hash));
+  if (keyframeInterval > 0 && frameCount % keyframeInterval == 0)
+    stream.write((const char*)pixels, screenSize);
+  frameCount++;
+}
+
+bool HashStream::readFrame(uint64_t& hash, const uint8_t *&keyframe) {
+  if (cursor == file->end())
+    return false;
+  bool isKeyframe = keyframeInterval > 0 && frameCount % keyframeInterval == 0;
+  size_t size = sizeof(hash) + (isKeyframe ? screenSize : 0);
+  if ((size_t)(file->end() - cursor) < size)
+    throw std::runtime_error(fileName + " is truncated");
+  std::memcpy(&hash, cursor, sizeof(hash));
+  keyframe = isKeyframe ? cursor + sizeof(hash) : NULL;
+  cursor += size;
+  frameCount++;
+  return true;
+}
+
+void HashStream::close() {
+  // the hash is usually only known once the stream was opened
+  stream.seekp(ROM_HASH_OFFSET);
+  stream.write((char*)&romHash, sizeof(romHash));
+  stream.close();
+}
+} // namespace utils
@@ -0,0 +1,42 @@
+#include "instrumentation.h"
+
+#include <iomanip>
+
+#include "logger.h"
+#include "utilities.h"
+
+namespace utils {
+
+namespace {
+const char *COUNTER_NAMES[COUNTER_COUNT] = {
+  "cpu bus reads",
+  "cpu bus writes",
+  "ppu bus reads",
+  "ppu bus writes",
+  "bank switches",
+  "interrupts",
+};
+const char *BUS_NAMES[2] = {"cpu", "ppu"};
+} // namespace
+
+Instrumentation Instrumentation::instance;
+
+Instrumentation::Instrumentation(): counters() {}
+
+void Instrumentation::report(Bus bus, uint16_t address, bool write, uint8_t value) {
+  // the logger is not kept as a member, as the instance is built before the
+  // loggers can be
+  Logger log = Logger::getLogger("Watch");
+  if (write)
+    log.info() << BUS_NAMES[bus] << " write " << hex(address) << " = " << hex(value) << "\n";
+  else
+    log.info() << BUS_NAMES[bus] << " read " << hex(address) << "\n";
+}
+
+void Instrumentation::printCounters(std::ostream& out) {
+  out << "counters\n";
+  for (int c = 0; c < COUNTER_COUNT; c++)
+    out << "  " << std::left << std::setw(16) << COUNTER_NAMES[c] << std::right << std::setw(16) << counters[c] << "\n";
+}
+
+} // namespace utils
@@ -1,68 +1,554 @@
 #include "logger.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+// RING_SLOTS is the number of slots in the ring of each thread (16k slots of
+// 32 bytes, 512KB)
+const size_t RING_SLOTS = 1 << 14;
+// MAX_STRING is the maximum number of characters kept for one argument, the
+// end of longer ones being replaced by TRUNCATED
+const size_t MAX_STRING = 4096;
+const char TRUNCATED[] = "...[truncated]";
+const char TRUNCATED_LINE[] = "...[truncated]\n";
+static_assert(Logger::MAX_VALUE <= MAX_STRING, "values are gathered in a buffer of MAX_STRING bytes");
+// WRITER_PERIOD is the maximum time between two passes of the writer thread
+const std::chrono::milliseconds WRITER_PERIOD(10);
+
+enum EventType: uint8_t {
+  // BEGIN starts a record: it holds the level, the logger and the timestamp
+  BEGIN,
+  // LITERAL is a string literal, stored as a pointer (it doubles as a format
+  // id, as it identifies the call site)
+  LITERAL,
+  // STRING is a copied string, VALUE the raw bytes of a plain value along with
+  // the function formatting it. Both store their bytes in the slot if they
+  // fit, and in the slots that follow otherwise.
+  STRING,
+  VALUE,
+};
+
+struct Slot {
+  EventType type;
+  uint8_t level;
+  // BEGIN: 1 if the header should be output, STRING and VALUE: byte count
+  uint16_t size;
+  uint32_t loggerId;
+  union {
+    const char *literal;
+    Logger::Formatter format;
+    uint64_t timestamp;
+  };
+  char data[16];
+};
+static_assert(sizeof(Slot) == 32, "log slots should be 32 bytes");
+
+// slotsFor returns the number of slots taken by an event carrying size bytes
+size_t slotsFor(size_t size) {
+  if (size <= sizeof(Slot::data))
+    return 1;
+  return 1 + (size + sizeof(Slot) - 1) / sizeof(Slot);
+}
+
+// Ring is a single producer, single consumer queue of slots. Indexes only grow
+// and are wrapped when accessing slots.
+struct Ring {
+  Slot slots[RING_SLOTS];
+  // head is the next slot read by the writer, tail the end of the records that
+  // are ready to be read
+  std::atomic<size_t> head;
+  std::atomic<size_t> tail;
+  // set once the thread owning the ring is done
+  std::atomic<bool> closed;
+
+  // producer side: end of the slots written so far (records between tail and
+  // staged are not complete yet), and latest known value of head
+  size_t staged;
+  size_t cachedHead;
+
+  // writer side: state of the record being read, if it continues past tail
+  uint32_t loggerId;
+  uint64_t lastTimestamp;
+
+  Ring(): head(0), tail(0), closed(false), staged(0), cachedHead(0), loggerId(0), lastTimestamp(0) {}
+
+  Slot& at(size_t index) { return slots[index & (RING_SLOTS - 1)]; }
+};
+
+// Output is a file (or the standard output) written by the writer thread
+struct Output {
+  std::ofstream file;
+  std::streambuf *buffer;
+  bool dirty;
+};
+
+// Backend owns the rings, the outputs, and the writer thread
+class Backend {
+  public:
+    Backend();
+    ~Backend();
+    // registerLogger returns the id of a new logger writing to fileName
+    int registerLogger(std::string name, std::string fileName);
+    Ring* addRing();
+    // wake asks the writer thread for a pass as soon as possible
+    void wake();
+    // flush returns once all the records committed before the call are written
+    void flush();
+    bool isWriterThread() const { return std::this_thread::get_id() == writer.get_id(); }
+  private:
+    struct LoggerInfo {
+      std::string name;
+      Output *output;
+      // the stream used to format the records of this logger, so that its
+      // formatting flags are kept from one record to the next
+      std::unique_ptr<std::ostream> stream;
+    };
+
+    // lock protects everything below but the writer thread. Loggers are never
+    // moved once registered.
+    std::mutex lock;
+    std::deque<LoggerInfo> loggers;
+    std::map<std::string, std::unique_ptr<Output>> outputs;
+    std::vector<Ring*> rings;
+    std::condition_variable wakeUp;
+    std::condition_variable flushDone;
+    bool stopping;
+    long flushRequests;
+    long flushesDone;
+
+    std::thread writer;
+
+    void run();
+    bool drain();
+    void emit(Ring *ring, size_t end);
+    LoggerInfo& loggerFor(uint32_t id);
+};
+
+Backend& backend() {
+  static Backend instance;
+  return instance;
+}
+
+std::terminate_handler previousTerminate = nullptr;
+void onTerminate();
+
+Backend::Backend(): stopping(false), flushRequests(0), flushesDone(0) {
+  writer = std::thread(&Backend::run, this);
+  previousTerminate = std::set_terminate(&onTerminate);
+}
+
+Backend::~Backend() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wakeUp.notify_one();
+  writer.join();
+  for (auto r: rings) {
+    delete r;
+  }
+}
+
+int Backend::registerLogger(std::string name, std::string fileName) {
+  std::lock_guard<std::mutex> guard(lock);
+  auto it = outputs.find(fileName);
+  if (it == outputs.end()) {
+    std::unique_ptr<Output> output(new Output());
+    if (fileName != "") {
+      output->file.open(fileName);
+      output->buffer = output->file.rdbuf();
+    } else {
+      output->buffer = std::cout.rdbuf();
+    }
+    output->dirty = false;
+    it = outputs.emplace(fileName, std::move(output)).first;
+  }
+  LoggerInfo info;
+  info.name = name;
+  info.output = it->second.get();
+  loggers.push_back(std::move(info));
+  return loggers.size() - 1;
+}
+
+Ring* Backend::addRing() {
+  Ring *ring = new Ring();
+  std::lock_guard<std::mutex> guard(lock);
+  rings.push_back(ring);
+  return ring;
+}
+
+void Backend::wake() { wakeUp.notify_one(); }
+
+void Backend::flush() {
+  std::unique_lock<std::mutex> guard(lock);
+  long request = ++flushRequests;
+  wakeUp.notify_one();
+  flushDone.wait(guard, [this, request] { return flushesDone >= request; });
+}
+
+void Backend::run() {
+  std::unique_lock<std::mutex> guard(lock);
+  while (true) {
+    // a pass started after a flush request (or the destruction of the
+    // backend) reads everything that was committed before it
+    bool stop = stopping;
+    long requests = flushRequests;
+    guard.unlock();
+    bool worked = drain();
+    guard.lock();
+    if (flushesDone < requests) {
+      flushesDone = requests;
+      flushDone.notify_all();
+    }
+    if (stop) {
+      return;
+    }
+    if (!worked && flushRequests == flushesDone && !stopping) {
+      wakeUp.wait_for(guard, WRITER_PERIOD);
+    }
+  }
+}
+
+// drain writes all the complete records, taking them from the rings in
+// timestamp order. It returns false if there was nothing to write.
+bool Backend::drain() {
+  std::vector<Ring*> current;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    current = rings;
+  }
+  std::vector<size_t> ends;
+  for (auto r: current) {
+    ends.push_back(r->tail.load(std::memory_order_acquire));
+  }
+
+  bool worked = false;
+  while (true) {
+    int next = -1;
+    uint64_t nextTimestamp = 0;
+    for (size_t i = 0; i < current.size(); i++) {
+      Ring *r = current[i];
+      size_t head = r->head.load(std::memory_order_relaxed);
+      if (head == ends[i]) {
+        continue;
+      }
+      // a ring that does not start with BEGIN continues a record that was
+      // committed in several parts
+      Slot& s = r->at(head);
+      uint64_t timestamp = s.type == BEGIN ? s.timestamp : r->lastTimestamp;
+      if (next == -1 || timestamp < nextTimestamp) {
+        next = i;
+        nextTimestamp = timestamp;
+      }
+    }
+    if (next == -1) {
+      break;
+    }
+    emit(current[next], ends[next]);
+    worked = true;
+  }
+
+  std::lock_guard<std::mutex> guard(lock);
+  for (auto& o: outputs) {
+    if (o.second->dirty) {
+      o.second->buffer->pubsync();
+      o.second->dirty = false;
+    }
+  }
+
+  // rings of threads that are done can go once they are empty
+  for (auto r: current) {
+    if (
+      r->closed.load(std::memory_order_acquire) &&
+      r->head.load(std::memory_order_relaxed) == r->tail.load(std::memory_order_acquire)
+    ) {
+      rings.erase(std::find(rings.begin(), rings.end(), r));
+      delete r;
+    }
+  }
+  return worked;
+}
+
+// emit formats one record of ring (stopping at the next BEGIN or at end)
+void Backend::emit(Ring *ring, size_t end) {
+  size_t index = ring->head.load(std::memory_order_relaxed);
+  Slot& first = ring->at(index);
+  if (first.type == BEGIN) {
+    ring->loggerId = first.loggerId;
+    ring->lastTimestamp = first.timestamp;
+  }
+  LoggerInfo& info = loggerFor(ring->loggerId);
+  std::ostream& out = *info.stream;
+
+  char bytes[MAX_STRING];
+  bool begun = false;
+  while (index != end) {
+    Slot& s = ring->at(index);
+    if (s.type == BEGIN) {
+      if (begun) {
+        break;
+      }
+      begun = true;
+      if (s.size) {
+        std::string label;
+        switch((LogLevel)s.level) {
+          case DEBUG: label = "DEBUG"; break;
+          case INFO: label = "INFO"; break;
+          case WARN: label = "WARN"; break;
+          case ERROR: label = "ERROR"; break;
+        }
+        out << "[" + label + "]" << " " << info.name << ": ";
+      }
+      index++;
+      continue;
+    }
+    begun = true;
+    if (s.type == LITERAL) {
+      out << s.literal;
+      index++;
+      continue;
+    }
+
+    // STRING or VALUE: gather the bytes
+    size_t size = s.size;
+    if (size <= sizeof(Slot::data)) {
+      std::memcpy(bytes, s.data, size);
+    } else {
+      for (size_t copied = 0; copied < size; copied += sizeof(Slot)) {
+        std::memcpy(
+          bytes + copied,
+          &ring->at(index + 1 + copied / sizeof(Slot)),
+          std::min(sizeof(Slot), size - copied)
+        );
+      }
+    }
+    if (s.type == STRING)
+      out.write(bytes, size);
+    else
+      s.format(out, bytes);
+    index += slotsFor(size);
+  }
+  ring->head.store(index, std::memory_order_release);
+}
+
+Backend::LoggerInfo& Backend::loggerFor(uint32_t id) {
+  std::lock_guard<std::mutex> guard(lock);
+  LoggerInfo& info = loggers[id];
+  if (!info.stream) {
+    info.stream.reset(new std::ostream(info.output->buffer));
+  }
+  info.output->dirty = true;
+  return info;
+}
+
+// commit makes the records written so far visible to the writer thread
+void commit(Ring *ring) {
+  if (ring->staged == ring->tail.load(std::memory_order_relaxed)) {
+    return;
+  }
+  ring->tail.store(ring->staged, std::memory_order_release);
+  if (ring->staged - ring->cachedHead > RING_SLOTS / 2) {
+    // the ring is getting full, unless the writer already caught up
+    ring->cachedHead = ring->head.load(std::memory_order_acquire);
+    if (ring->staged - ring->cachedHead > RING_SLOTS / 2)
+      backend().wake();
+  }
+}
+
+// LocalRing holds the ring of the current thread, and hands its last record
+// over to the writer when the thread is done
+struct LocalRing {
+  Ring *ring = nullptr;
+  ~LocalRing() {
+    if (ring != nullptr) {
+      commit(ring);
+      ring->closed.store(true, std::memory_order_release);
+      backend().wake();
+    }
+  }
+};
+
+thread_local LocalRing localRing;
+
+// onTerminate writes what was logged before the program is aborted (by an
+// uncaught exception for instance), records of other threads included
+void onTerminate() {
+  if (!backend().isWriterThread()) {
+    if (localRing.ring != nullptr)
+      commit(localRing.ring);
+    backend().flush();
+  }
+  if (previousTerminate != nullptr)
+    previousTerminate();
+  std::abort();
+}
+
+Ring* currentRing() {
+  if (localRing.ring == nullptr) {
+    localRing.ring = backend().addRing();
+  }
+  return localRing.ring;
+}
+
+// reserve returns the index of count free slots in ring, waiting for the writer
+// if needed
+size_t reserve(Ring *ring, size_t count) {
+  while (ring->staged + count - ring->cachedHead > RING_SLOTS) {
+    ring->cachedHead = ring->head.load(std::memory_order_acquire);
+    if (ring->staged + count - ring->cachedHead <= RING_SLOTS) {
+      break;
+    }
+    // the ring is full: let the writer catch up. If the record being written
+    // is too large to ever fit, hand it over in several parts.
+    if (ring->staged - ring->tail.load(std::memory_order_relaxed) + count > RING_SLOTS)
+      commit(ring);
+    backend().wake();
+    std::this_thread::yield();
+  }
+  size_t index = ring->staged;
+  ring->staged += count;
+  return index;
+}
+
+// appendBytes writes an event carrying size bytes
+void appendBytes(EventType type, Logger::Formatter format, const void* value, size_t size) {
+  Ring *ring = currentRing();
+  size_t index = reserve(ring, slotsFor(size));
+  Slot& s = ring->at(index);
+  s.type = type;
+  s.size = size;
+  s.format = format;
+  const char *bytes = static_cast<const char*>(value);
+  if (size <= sizeof(Slot::data)) {
+    std::memcpy(s.data, bytes, size);
+    return;
+  }
+  for (size_t copied = 0; copied < size; copied += sizeof(Slot)) {
+    std::memcpy(
+      &ring->at(index + 1 + copied / sizeof(Slot)),
+      bytes + copied,
+      std::min(sizeof(Slot), size - copied)
+    );
+  }
+}
+} // namespace
+
 
 std::map<std::string, Logger> Logger::loggerMap = std::map<std::string, Logger>();
 
+std::mutex Logger::registryLock;
+
 Logger Logger::getLogger(std::string name, std::string fileName) {
+  std::lock_guard<std::mutex> guard(registryLock);
   std::map<std::string, Logger>::iterator it = loggerMap.find(name);
   if (it != loggerMap.end())
     return it->second;
-  else
-    return (loggerMap.emplace(std::make_pair(name, Logger(name, fileName))).first)->second;
-}
-
-Logger::Logger(const Logger& log):
-  name(log.name),
-  outputFileName(log.outputFileName),
-  level(log.level),
-  out(buf)
-{
-  if (outputFileName != "") {
-    of.open(outputFileName);
-    buf = of.rdbuf();
+  else {
+    int id = backend().registerLogger(name, fileName);
+    return (loggerMap.emplace(std::make_pair(name, Logger(name, id))).first)->second;
   }
-  else
-    buf = std::cout.rdbuf();
-  out.rdbuf(buf);
 }
 
-Logger::Logger(std::string _name, std::string fileName):
-  name(_name),
-  outputFileName(fileName),
-  level(INFO),
-  out(buf)
-{
-  if (outputFileName != "") {
-    of.open(outputFileName);
-    buf = of.rdbuf();
+void Logger::flush() {
+  if (localRing.ring != nullptr) {
+    commit(localRing.ring);
   }
-  else
-    buf = std::cout.rdbuf();
-  out.rdbuf(buf);
+  backend().flush();
 }
 
-void Logger::outputHeader(LogLevel l) {
-  std::string label;
-  switch(l) {
-    case DEBUG: label = "DEBUG"; break;
-    case INFO: label = "INFO"; break;
-    case WARN: label = "WARN"; break;
-    case ERROR: label = "ERROR"; break;
-  }
-  out << "[" + label + "]" << " " << name << ": ";
-}
+Logger::Logger(std::string _name, int _id):
+  name(_name),
+  id(_id),
+  level(INFO)
+{}
 
 Logger& Logger::log(LogLevel l) {
   if (level > l)
     outputEnabled = false;
   else {
     outputEnabled = true;
-    if (headerEnabled)
-      outputHeader(l);
+    // the previous record of this thread is complete
+    Ring *ring = currentRing();
+    commit(ring);
+    Slot& s = ring->at(reserve(ring, 1));
+    s.type = BEGIN;
+    s.level = l;
+    s.size = headerEnabled;
+    s.loggerId = id;
+    s.timestamp = std::chrono::steady_clock::now().time_since_epoch().count();
   }
   return *this;
 }
 
+void Logger::appendValue(Formatter format, const void* value, size_t size) {
+  appendBytes(VALUE, format, value, size);
+}
+
+void Logger::appendLiteral(const char* msg) {
+  Ring *ring = currentRing();
+  Slot& s = ring->at(reserve(ring, 1));
+  s.type = LITERAL;
+  s.literal = msg;
+  size_t length = std::strlen(msg);
+  if (length > 0 && msg[length - 1] == '\n')
+    commit(ring);
+}
+
+void Logger::appendString(const char* msg, size_t length) {
+  if (length > MAX_STRING) {
+    appendBytes(STRING, nullptr, msg, MAX_STRING);
+    appendLiteral(msg[length - 1] == '\n' ? TRUNCATED_LINE : TRUNCATED);
+    return;
+  }
+  appendBytes(STRING, nullptr, msg, length);
+  if (length > 0 && msg[length - 1] == '\n')
+    commit(currentRing());
+}
+
+Logger& Logger::operator<< (Literal msg) {
+  if (outputEnabled)
+    appendLiteral(msg.text);
+  return *this;
+}
+
+Logger& Logger::operator<< (const char* msg) {
+  if (outputEnabled)
+    appendString(msg, std::strlen(msg));
+  return *this;
+}
+
+Logger& Logger::operator<< (char* msg) {
+  return *this << (const char*)msg;
+}
+
+Logger& Logger::operator<< (const std::string& msg) {
+  if (outputEnabled)
+    appendString(msg.data(), msg.size());
+  return *this;
+}
+
+Logger& Logger::operator<< (std::ostream& (*manipulator)(std::ostream&)) {
+  if (outputEnabled)
+    appendValue(&Logger::format<std::ostream& (*)(std::ostream&)>, &manipulator, sizeof(manipulator));
+  return *this;
+}
+
+Logger& Logger::operator<< (std::ios_base& (*manipulator)(std::ios_base&)) {
+  if (outputEnabled)
+    appendValue(&Logger::format<std::ios_base& (*)(std::ios_base&)>, &manipulator, sizeof(manipulator));
+  return *this;
+}
+
 Logger& Logger::debug() {
   return log(DEBUG);
 }
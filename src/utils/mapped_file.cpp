@@ -0,0 +1,50 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace utils {
+MappedFile::MappedFile(std::string fileName): bytes(NULL), length(0) {
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("could not open " + fileName);
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    throw std::runtime_error("could not read " + fileName);
+  }
+  length = info.st_size;
+  if (length < MAP_THRESHOLD) {
+    buffer.resize(length);
+    size_t done = 0;
+    while (done < length) {
+      ssize_t n = ::read(fd, buffer.data() + done, length - done);
+      if (n <= 0) {
+        close(fd);
+        throw std::runtime_error("could not read " + fileName);
+      }
+      done += n;
+    }
+    close(fd);
+    bytes = buffer.data();
+    return;
+  }
+  void *mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid once the file is closed
+  close(fd);
+  if (mapped == MAP_FAILED)
+    throw std::runtime_error("could not map " + fileName);
+  // logs are read from start to end
+  madvise(mapped, length, MADV_SEQUENTIAL);
+  bytes = static_cast<const uint8_t*>(mapped);
+}
+
+MappedFile::~MappedFile() {
+  if (buffer.empty() && bytes != NULL)
+    munmap((void*)bytes, length);
+}
+} // namespace utils
@@ -0,0 +1,119 @@
+#include "profiler.h"
+
+#include <fstream>
+#include <iomanip>
+
+namespace utils {
+
+namespace {
+const char *ZONE_NAMES[ZONE_COUNT] = {
+  "cpu",
+  "ppu (background and pixels)",
+  "ppu sprites",
+  "render",
+  "screen log",
+};
+} // namespace
+
+Profiler Profiler::instance;
+thread_local ProfileScope *ProfileScope::innermost = nullptr;
+
+Profiler::Profiler():
+  current(), total(), totalFrameTicks(0), frameCount(0),
+  startTicks(readTicks()), startTime(std::chrono::steady_clock::now())
+{
+  current.start = startTicks;
+}
+
+void Profiler::endFrame() {
+  current.end = readTicks();
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    total.ticks[z] += current.ticks[z];
+    total.calls[z] += current.calls[z];
+  }
+  totalFrameTicks += current.end - current.start;
+  if (frames.size() < TRACE_FRAMES)
+    frames.push_back(current);
+  else
+    frames[frameCount % TRACE_FRAMES] = current;
+  frameCount++;
+
+  uint64_t end = current.end;
+  current = Frame();
+  current.start = end;
+}
+
+double Profiler::ticksPerMicrosecond() {
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - startTime;
+  uint64_t ticks = readTicks() - startTicks;
+  return elapsed.count() > 0 ? ticks / elapsed.count() : 1;
+}
+
+void Profiler::printTable(std::ostream& out) {
+  if (frameCount == 0) {
+    out << "profiler: no complete frame\n";
+    return;
+  }
+  double perMicro = ticksPerMicrosecond();
+  double frameTime = totalFrameTicks / perMicro / frameCount;
+  double tracked = 0;
+  out << std::left << std::setw(16) << "zone"
+    << std::right << std::setw(12) << "us/frame" << std::setw(8) << "%"
+    << std::setw(14) << "calls/frame" << "\n";
+  out << std::fixed;
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    double time = total.ticks[z] / perMicro / frameCount;
+    tracked += time;
+    out << std::left << std::setw(16) << ZONE_NAMES[z] << std::right
+      << std::setprecision(1) << std::setw(12) << time
+      << std::setw(8) << 100 * time / frameTime
+      << std::setprecision(0) << std::setw(14) << (double)total.calls[z] / frameCount << "\n";
+  }
+  out << std::left << std::setw(16) << "untracked" << std::right
+    << std::setprecision(1) << std::setw(12) << frameTime - tracked
+    << std::setw(8) << 100 * (frameTime - tracked) / frameTime << "\n";
+  out << std::left << std::setw(16) << "frame" << std::right
+    << std::setw(12) << frameTime << " (" << frameCount << " frames)\n";
+}
+
+void Profiler::printCurrentFrame(std::ostream& out) {
+  double perMicro = ticksPerMicrosecond();
+  out << std::fixed << std::setprecision(1);
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    if (current.calls[z] > 0)
+      out << "  " << std::left << std::setw(16) << ZONE_NAMES[z] << std::right
+        << std::setw(12) << current.ticks[z] / perMicro << " us\n";
+  }
+}
+
+// Each frame is an event, with one event per zone below it. The time of a
+// zone is spread over the whole frame, so zones are laid out one after the
+// other: only their duration is meaningful, not their position.
+void Profiler::writeTrace(std::string path) {
+  std::ofstream out(path);
+  double perMicro = ticksPerMicrosecond();
+  size_t first = frameCount > (long)TRACE_FRAMES ? frameCount % TRACE_FRAMES : 0;
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"frames\"}},\n";
+  out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"zones\"}}";
+  for (size_t i = 0; i < frames.size(); i++) {
+    const Frame& f = frames[(first + i) % frames.size()];
+    long number = frameCount - frames.size() + i;
+    double ts = (f.start - startTicks) / perMicro;
+    out << ",\n{\"name\": \"frame " << number << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1"
+      << ", \"ts\": " << ts << ", \"dur\": " << (f.end - f.start) / perMicro << "}";
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      if (f.calls[z] == 0)
+        continue;
+      double duration = f.ticks[z] / perMicro;
+      out << ",\n{\"name\": \"" << ZONE_NAMES[z] << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": 2"
+        << ", \"ts\": " << ts << ", \"dur\": " << duration
+        << ", \"args\": {\"calls\": " << f.calls[z] << "}}";
+      ts += duration;
+    }
+  }
+  out << "\n]}\n";
+}
+
+} // namespace utils
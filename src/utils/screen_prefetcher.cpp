@@ -0,0 +1,115 @@
+#include "screen_prefetcher.h"
+
+#include <chrono>
+#include <stdexcept>
+
+namespace utils {
+namespace {
+// how long waiting threads sleep at most without being notified
+const std::chrono::milliseconds WAIT_PERIOD(5);
+} // namespace
+
+ScreenPrefetcher::ScreenPrefetcher(std::string fileName, int size, int queueFrames):
+  stream(fileName, StreamMode::IN, size),
+  screenSize(size),
+  queue(queueFrames, Frame{std::vector<uint8_t>(size), 0, ""}),
+  holding(false),
+  position(0),
+  stopping(false)
+{
+  start();
+}
+
+ScreenPrefetcher::~ScreenPrefetcher() {
+  stop();
+}
+
+void ScreenPrefetcher::start() {
+  stopping.store(false);
+  decoder = std::thread(&ScreenPrefetcher::run, this);
+}
+
+void ScreenPrefetcher::stop() {
+  stopping.store(true);
+  slotAvailable.notify_one();
+  if (decoder.joinable())
+    decoder.join();
+}
+
+const uint8_t* ScreenPrefetcher::next(int& size) {
+  if (holding) {
+    queue.pop();
+    slotAvailable.notify_one();
+  }
+  Frame *frame = queue.front();
+  if (frame == NULL) {
+    std::unique_lock<std::mutex> guard(lock);
+    while ((frame = queue.front()) == NULL)
+      frameAvailable.wait_for(guard, WAIT_PERIOD);
+  }
+  if (!frame->error.empty())
+    throw std::runtime_error(frame->error);
+  // the end of the log is kept at the front, so that next keeps returning it
+  holding = frame->size > 0;
+  if (holding)
+    position++;
+  size = frame->size;
+  return frame->pixels.data();
+}
+
+void ScreenPrefetcher::seek(long frame) {
+  long decoded = queue.size() - (holding ? 1 : 0);
+  if (frame >= position && frame - position < decoded) {
+    int size;
+    while (position < frame)
+      next(size);
+    return;
+  }
+  // checked before stopping the decoder, so that it can go on if this fails
+  if (stream.getFormat() != SCREEN_V2)
+    throw std::runtime_error("only v2 screen logs can be seeked");
+  if (frame < 0 || frame > stream.getFrameCount())
+    throw std::runtime_error("no frame " + std::to_string(frame) + " in the screen log");
+
+  stop();
+  while (queue.front() != NULL)
+    queue.pop();
+  holding = false;
+  position = frame;
+  try {
+    stream.seek(frame);
+  } catch (const std::exception& e) {
+    // reported by next, as decoding errors are, and nothing is decoded after
+    Frame *end = queue.back();
+    end->size = 0;
+    end->error = e.what();
+    queue.push();
+    return;
+  }
+  start();
+}
+
+// run decodes frames until the end of the log, which it signals with an empty
+// frame
+void ScreenPrefetcher::run() {
+  while (!stopping.load()) {
+    Frame *frame = queue.back();
+    if (frame == NULL) {
+      std::unique_lock<std::mutex> guard(lock);
+      slotAvailable.wait_for(guard, WAIT_PERIOD);
+      continue;
+    }
+    frame->error.clear();
+    try {
+      frame->size = stream.readPixels(frame->pixels.data());
+    } catch (const std::exception& e) {
+      frame->size = 0;
+      frame->error = e.what();
+    }
+    queue.push();
+    frameAvailable.notify_one();
+    if (frame->size == 0)
+      return;
+  }
+}
+} // namespace utils
@@ -0,0 +1,92 @@
+#include "screen_recorder.h"
+
+#include <chrono>
+
+namespace utils {
+namespace {
+// how long waiting threads sleep at most without being notified
+const std::chrono::milliseconds WAIT_PERIOD(5);
+} // namespace
+
+ScreenRecorder::ScreenRecorder(std::string fileName, int size, RecorderPolicy p):
+  stream(fileName, StreamMode::OUT, size),
+  screenSize(size),
+  policy(p),
+  queue(QUEUE_FRAMES, Frame{std::vector<uint8_t>(size), size}),
+  current(NULL),
+  spare{std::vector<uint8_t>(size), size},
+  cursor(NULL),
+  frameEnd(NULL),
+  droppedFrames(0),
+  closed(false),
+  stopping(false)
+{
+  nextFrame();
+  writer = std::thread(&ScreenRecorder::run, this);
+}
+
+ScreenRecorder::~ScreenRecorder() {
+  close();
+}
+
+void ScreenRecorder::pushFrame() {
+  if (current == &spare) {
+    droppedFrames++;
+  } else {
+    current->size = cursor - current->pixels.data();
+    queue.push();
+    frameAvailable.notify_one();
+  }
+  nextFrame();
+}
+
+void ScreenRecorder::nextFrame() {
+  current = queue.back();
+  if (current == NULL && policy == DROP_WHEN_FULL) {
+    current = &spare;
+  } else if (current == NULL) {
+    std::unique_lock<std::mutex> guard(lock);
+    while ((current = queue.back()) == NULL)
+      slotAvailable.wait_for(guard, WAIT_PERIOD);
+  }
+  cursor = current->pixels.data();
+  frameEnd = cursor + screenSize;
+}
+
+void ScreenRecorder::close() {
+  if (closed)
+    return;
+  closed = true;
+  if (cursor != current->pixels.data())
+    pushFrame();
+  stopping.store(true);
+  frameAvailable.notify_one();
+  writer.join();
+  stream.close();
+}
+
+// run writes the frames as they come, until the recorder is closed and the
+// queue is empty
+void ScreenRecorder::run() {
+  while (true) {
+    // frames pushed before stopping was set are visible once it is
+    bool done = stopping.load();
+    Frame *frame = queue.front();
+    if (frame == NULL) {
+      if (done)
+        return;
+      std::unique_lock<std::mutex> guard(lock);
+      frameAvailable.wait_for(guard, WAIT_PERIOD);
+      continue;
+    }
+    if (frame->size == screenSize) {
+      stream.writeFrame(frame->pixels.data());
+    } else {
+      for (int i = 0; i < frame->size; i++)
+        stream.write(frame->pixels[i]);
+    }
+    queue.pop();
+    slotAvailable.notify_one();
+  }
+}
+} // namespace utils
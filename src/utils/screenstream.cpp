@@ -1,21 +1,100 @@
 #include "screenstream.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
+
+#include "profiler.h"
+#include "varint.h"
 
 namespace utils {
-ScreenStream::ScreenStream(std::string fileName, StreamMode mode, int screenSize):
-  colorAggregator(0xffff)
+const char ScreenStream::SIGNATURE[3] = {'S', 'C', 'R'};
+const char ScreenStream::TRAILER_SIGNATURE[4] = {'S', 'I', 'D', 'X'};
+
+namespace {
+std::runtime_error corruptedError() {
+  return std::runtime_error("corrupted screen log");
+}
+} // namespace
+
+ScreenStream::ScreenStream(std::string name, StreamMode mode, int size, ScreenFormat f):
+  file(NULL),
+  fileName(name),
+  format(f),
+  screenSize(size),
+  chunkFrames(CHUNK_FRAMES),
+  romHash(0),
+  colorAggregator(0xffff),
+  frame(size),
+  previous(size),
+  position(0),
+  available(0),
+  frameCount(0),
+  indexOffset(0),
+  cursor(NULL),
+  chunkEnd(NULL),
+  nextChunk(0)
 {
   switch (mode) {
     case StreamMode::IN:
-      stream.open(fileName, std::ios::binary | std::ios::in);
+      file = new MappedFile(fileName);
+      // v1 files start with a run, the first byte of which is never 'S'
+      format = SCREEN_V1;
+      cursor = file->data();
+      chunkEnd = file->end();
+      if (file->size() > 0 && file->data()[0] == SIGNATURE[0]) {
+        format = SCREEN_V2;
+        readIndex();
+      }
       break;
     case StreamMode::OUT:
       stream.open(fileName, std::ios::binary | std::ios::out);
+      if (format == SCREEN_V2) {
+        if (screenSize % ROW_SIZE != 0)
+          throw std::runtime_error("screen size must be a multiple of the row size");
+        uint8_t version = 2;
+        uint32_t header[] = {(uint32_t)screenSize, (uint32_t)chunkFrames, romHash};
+        stream.write(SIGNATURE, sizeof(SIGNATURE));
+        stream.write((char*)&version, sizeof(version));
+        stream.write((char*)header, sizeof(header));
+      }
       break;
   }
 }
 
+ScreenStream::~ScreenStream() {
+  delete file;
+}
+
 void ScreenStream::write(uint8_t palette) {
+  if (format == SCREEN_V1) {
+    writeV1(palette);
+    return;
+  }
+  frame[position++] = palette;
+  if (position == screenSize)
+    encodeFrame(screenSize);
+}
+
+void ScreenStream::writeFrame(const uint8_t *pixels) {
+  if (format == SCREEN_V1) {
+    PROFILE_SCOPE(SCREEN_LOG_ZONE);
+    record.clear();
+    colorAggregator.loadAll(pixels, screenSize, record);
+    stream.write(record.data(), record.size());
+    return;
+  }
+  if (position != 0) {
+    for (int i = 0; i < screenSize; i++)
+      write(pixels[i]);
+    return;
+  }
+  std::copy(pixels, pixels + screenSize, frame.begin());
+  encodeFrame(screenSize);
+}
+
+void ScreenStream::writeV1(uint8_t palette) {
+  PROFILE_SCOPE(SCREEN_LOG_ZONE);
   if (!colorAggregator.canLoad(palette)) {
     auto aggregated = colorAggregator.aggregate();
     stream << aggregated;
@@ -24,49 +103,268 @@ void ScreenStream::write(uint8_t palette) {
   colorAggregator.load(palette);
 }
 
+// encodeFrame writes the first size pixels of frame, size being screenSize
+// unless the stream is closed in the middle of a frame
+void ScreenStream::encodeFrame(int size) {
+  PROFILE_SCOPE(SCREEN_LOG_ZONE);
+  record.clear();
+  bool chunkStart = frameCount % chunkFrames == 0;
+  if (chunkStart)
+    chunkOffsets.push_back(stream.tellp());
+  if (size < screenSize) {
+    record.push_back(PARTIAL);
+    appendVarint(record, size);
+    appendRuns(frame.data(), NULL, size);
+  } else if (chunkStart) {
+    record.push_back(KEYFRAME);
+    appendRuns(frame.data(), NULL, size);
+  } else {
+    int rows = screenSize / ROW_SIZE;
+    std::vector<uint8_t> changed((rows + 7) / 8);
+    bool any = false;
+    for (int row = 0; row < rows; row++) {
+      int start = row * ROW_SIZE;
+      if (std::memcmp(&frame[start], &previous[start], ROW_SIZE) != 0) {
+        changed[row / 8] |= 1 << (row % 8);
+        any = true;
+      }
+    }
+    if (!any) {
+      record.push_back(REPEAT);
+    } else {
+      record.push_back(DELTA);
+      record.append(changed.begin(), changed.end());
+      for (int row = 0; row < rows; row++) {
+        if (changed[row / 8] & (1 << (row % 8)))
+          appendRuns(&frame[row * ROW_SIZE], &previous[row * ROW_SIZE], ROW_SIZE);
+      }
+    }
+  }
+  stream.write(record.data(), record.size());
+  std::swap(frame, previous);
+  position = 0;
+  if (size == screenSize)
+    frameCount++;
+}
+
+// appendRuns encodes size pixels as runs, pixels equal to those of reference
+// (if any) being KEEP
+void ScreenStream::appendRuns(const uint8_t *pixels, const uint8_t *reference, int size) {
+  int i = 0;
+  while (i < size) {
+    uint8_t value = reference != NULL && pixels[i] == reference[i] ? KEEP : pixels[i];
+    int j = i + 1;
+    if (reference == NULL) {
+      j = findRunEnd(pixels, i, size);
+    } else if (value == KEEP) {
+      while (j < size && pixels[j] == reference[j])
+        j++;
+    } else {
+      while (j < size && pixels[j] == value && reference[j] != value)
+        j++;
+    }
+    appendVarint(record, j - i);
+    record.push_back(value);
+    i = j;
+  }
+}
+
 void ScreenStream::close() {
-  auto leftover = colorAggregator.aggregate();
-  stream << leftover;
-  stream.write((char*)&SCREENSTREAM_END, sizeof(SCREENSTREAM_END));
+  if (format == SCREEN_V1) {
+    auto leftover = colorAggregator.aggregate();
+    stream << leftover;
+    stream.write((char*)&SCREENSTREAM_END, sizeof(SCREENSTREAM_END));
+  } else {
+    if (position != 0)
+      encodeFrame(position);
+    stream.write((char*)&SCREENSTREAM_END, sizeof(SCREENSTREAM_END));
+    writeIndex();
+  }
   stream.close();
 }
 
-uint8_t ScreenStream::read() {
-  if (currentColor.count != 0) {
-    currentColor.count--;
-    return currentColor.val;
+void ScreenStream::writeIndex() {
+  Trailer trailer;
+  trailer.indexOffset = stream.tellp();
+  trailer.frameCount = frameCount;
+  trailer.chunkCount = chunkOffsets.size();
+  std::memcpy(trailer.signature, TRAILER_SIGNATURE, sizeof(TRAILER_SIGNATURE));
+  stream.write((char*)chunkOffsets.data(), chunkOffsets.size() * sizeof(uint64_t));
+  stream.write((char*)&trailer, sizeof(trailer));
+  // the hash is usually only known once the stream was opened
+  stream.seekp(ROM_HASH_OFFSET);
+  stream.write((char*)&romHash, sizeof(romHash));
+}
+
+void ScreenStream::readIndex() {
+  const uint8_t *data = file->data();
+  const size_t headerSize = sizeof(SIGNATURE) + 1 + 3 * sizeof(uint32_t);
+  uint32_t header[3];
+  if (
+    file->size() < headerSize ||
+    std::memcmp(data, SIGNATURE, sizeof(SIGNATURE)) != 0 ||
+    data[sizeof(SIGNATURE)] != 2
+  )
+    throw std::runtime_error(fileName + " is not a screen log");
+  std::memcpy(header, data + sizeof(SIGNATURE) + 1, sizeof(header));
+  if ((int)header[0] != screenSize)
+    throw std::runtime_error(fileName + " was written for another screen size");
+  chunkFrames = header[1];
+  romHash = header[2];
+
+  Trailer trailer;
+  if (file->size() < headerSize + sizeof(trailer))
+    throw std::runtime_error(fileName + " has no index (it was not closed)");
+  std::memcpy(&trailer, file->end() - sizeof(trailer), sizeof(trailer));
+  if (std::memcmp(trailer.signature, TRAILER_SIGNATURE, sizeof(TRAILER_SIGNATURE)) != 0)
+    throw std::runtime_error(fileName + " has no index (it was not closed)");
+  indexOffset = trailer.indexOffset;
+  frameCount = trailer.frameCount;
+  size_t indexSize = trailer.chunkCount * sizeof(uint64_t);
+  if (chunkFrames <= 0 || indexOffset < headerSize || indexOffset + indexSize + sizeof(trailer) != file->size())
+    throw std::runtime_error(fileName + " has a corrupted index");
+  chunkOffsets.resize(trailer.chunkCount);
+  std::memcpy(chunkOffsets.data(), data + indexOffset, indexSize);
+  for (size_t i = 0; i < chunkOffsets.size(); i++) {
+    uint64_t next = i + 1 < chunkOffsets.size() ? chunkOffsets[i + 1] : indexOffset - 1;
+    if (chunkOffsets[i] < headerSize || chunkOffsets[i] > next)
+      throw std::runtime_error(fileName + " has a corrupted index");
   }
+  // decodeFrame starts with the first chunk
+  cursor = chunkEnd = NULL;
+}
+
+// findChunk sets begin and end to the encoded frames of a chunk (the last one
+// ends with SCREENSTREAM_END)
+void ScreenStream::findChunk(int index, const uint8_t *&begin, const uint8_t *&end) {
+  if (format != SCREEN_V2 || index < 0 || index >= (int)chunkOffsets.size())
+    throw std::runtime_error("no chunk " + std::to_string(index) + " in " + fileName);
+  begin = file->data() + chunkOffsets[index];
+  end = file->data() + (index + 1 < (int)chunkOffsets.size() ? chunkOffsets[index + 1] : indexOffset - 1);
+}
+
+std::vector<uint8_t> ScreenStream::readChunk(int index) {
+  const uint8_t *begin, *end;
+  findChunk(index, begin, end);
+  return std::vector<uint8_t>(begin, end);
+}
 
-  if ((uint8_t)stream.peek() == SCREENSTREAM_END) {
-    return SCREENSTREAM_END;
+long ScreenStream::decodeChunk(const std::vector<uint8_t>& bytes, int screenSize, std::vector<uint8_t>& pixels) {
+  std::vector<uint8_t> current(screenSize);
+  const uint8_t *data = bytes.data();
+  const uint8_t *end = data + bytes.size();
+  long count = 0;
+  while (data < end) {
+    int size = decodeRecord(data, end, current.data(), screenSize);
+    pixels.insert(pixels.end(), current.begin(), current.begin() + size);
+    count += size;
   }
+  return count;
+}
 
-  stream >> currentColor;
-
-  // uint8_t byte;
-  // stream.read((char*)&byte, sizeof(byte));
-
-  // // XXX: Because we know that we never write anything > 63 (0x3f) to the
-  // // ByteAggregator, the only way we get something bigger than 0xbf is when we
-  // // stumble upon SCREENSTREAM_END, in which case we can return directly
-  // if (byte == SCREENSTREAM_END) {
-  //   return SCREENSTREAM_END;
-  // }
-
-  // // discard msb
-  // currentColor = byte & 0x7f;
-  // // decide how to fill count depending on the msb
-  // if ((byte >> 7) == 0) {
-  //   // in this case, we have only one byte of count, so reuse byte
-  //   stream.read((char*)&byte, sizeof(byte));
-  //   count = byte;
-  // } else {
-  //   // in this case, we have only one byte of count, so reuse byte
-  //   stream.read((char*)&count, sizeof(count));
-  // }
-
-  currentColor.count--;
-  return currentColor.val;
+void ScreenStream::seek(long target) {
+  if (format != SCREEN_V2)
+    throw std::runtime_error("only v2 screen logs can be seeked");
+  if (target < 0 || target > frameCount)
+    throw std::runtime_error("no frame " + std::to_string(target) + " in " + fileName);
+  position = 0;
+  available = 0;
+  cursor = chunkEnd = NULL;
+  nextChunk = target / chunkFrames;
+  // decode the frames of the chunk that come before target
+  for (long i = 0; i < target % chunkFrames; i++)
+    decodeFrame();
+  position = available;
 }
-} // namespace utils
 
+int ScreenStream::readPixels(uint8_t *pixels) {
+  int count = 0;
+  while (count < screenSize) {
+    if (position == available && !decodeFrame())
+      break;
+    int n = std::min(available - position, screenSize - count);
+    std::memcpy(pixels + count, &frame[position], n);
+    position += n;
+    count += n;
+  }
+  return count;
+}
+
+bool ScreenStream::decodeFrame() {
+  if (format == SCREEN_V1)
+    return decodeFrameV1();
+  position = 0;
+  available = 0;
+  if (cursor == chunkEnd) {
+    if (nextChunk >= (int)chunkOffsets.size())
+      return false;
+    findChunk(nextChunk++, cursor, chunkEnd);
+  }
+  available = decodeRecord(cursor, chunkEnd, frame.data(), screenSize);
+  return true;
+}
+
+// decodeRecord decodes the record at data to pixels, which hold the previous
+// frame, and returns the number of pixels of the frame
+int ScreenStream::decodeRecord(const uint8_t *&data, const uint8_t *end, uint8_t *pixels, int screenSize) {
+  auto takeVarint = [&]() -> uint64_t {
+    uint64_t value;
+    if (!readVarint(data, end, value))
+      throw corruptedError();
+    return value;
+  };
+  auto readRuns = [&](uint8_t *out, int size) {
+    int i = 0;
+    while (i < size) {
+      uint64_t count = takeVarint();
+      if (data == end || count == 0 || count > (uint64_t)(size - i))
+        throw corruptedError();
+      uint8_t value = *data++;
+      if (value != KEEP)
+        std::memset(out + i, value, count);
+      i += count;
+    }
+  };
+
+  if (data == end)
+    throw corruptedError();
+  int rows = screenSize / ROW_SIZE;
+  switch (*data++) {
+    case KEYFRAME:
+      readRuns(pixels, screenSize);
+      return screenSize;
+    case DELTA: {
+      const uint8_t *changed = data;
+      if (end - data < (rows + 7) / 8)
+        throw corruptedError();
+      data += (rows + 7) / 8;
+      for (int row = 0; row < rows; row++) {
+        if (changed[row / 8] & (1 << (row % 8)))
+          readRuns(pixels + row * ROW_SIZE, ROW_SIZE);
+      }
+      return screenSize;
+    }
+    case REPEAT:
+      return screenSize;
+    case PARTIAL: {
+      uint64_t size = takeVarint();
+      if (size > (uint64_t)screenSize)
+        throw corruptedError();
+      readRuns(pixels, size);
+      return size;
+    }
+    default:
+      throw corruptedError();
+  }
+}
+
+// decodeFrameV1 fills frame with the runs of the file. A run can go on over
+// several frames.
+bool ScreenStream::decodeFrameV1() {
+  // XXX: Because we know that we never write anything > 63 (0x3f) to the
+  // ByteAggregator, the first byte of a run is never SCREENSTREAM_END
+  available = decodeAggrBytes(cursor, chunkEnd, currentColor, frame.data(), screenSize);
+  position = 0;
+  return available > 0;
+}
+} // namespace utils
@@ -0,0 +1,35 @@
+#include "state_buffer.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace utils {
+StateBuffer::StateBuffer(): cursor(0) {}
+
+void StateBuffer::write(const void* value, size_t size) {
+  size_t offset = bytes.size();
+  bytes.resize(offset + size);
+  std::memcpy(bytes.data() + offset, value, size);
+}
+
+void StateBuffer::read(void* value, size_t size) {
+  if (cursor + size > bytes.size()) {
+    throw std::runtime_error("reading past the end of a StateBuffer");
+  }
+  std::memcpy(value, bytes.data() + cursor, size);
+  cursor += size;
+}
+
+void StateBuffer::seekStart() { cursor = 0; }
+
+void StateBuffer::clear() {
+  bytes.clear();
+  cursor = 0;
+}
+
+size_t StateBuffer::size() const { return bytes.size(); }
+
+uint8_t* StateBuffer::data() { return bytes.data(); }
+
+const uint8_t* StateBuffer::data() const { return bytes.data(); }
+} // namespace utils
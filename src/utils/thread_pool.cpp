@@ -0,0 +1,105 @@
+#include "thread_pool.h"
+
+namespace utils {
+ThreadPool::ThreadPool(int size): pending(0), queued(0), stopping(false), nextWorker(0) {
+  if (size <= 0) {
+    size = std::thread::hardware_concurrency();
+  }
+  if (size <= 0) {
+    size = 1;
+  }
+  for (int i = 0; i < size; i++) {
+    workers.push_back(new Worker());
+  }
+  for (int i = 0; i < size; i++) {
+    threads.push_back(std::thread(&ThreadPool::run, this, i));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  wait();
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  workAvailable.notify_all();
+  for (auto& t: threads) {
+    t.join();
+  }
+  for (auto w: workers) {
+    delete w;
+  }
+}
+
+void ThreadPool::submit(Task task) {
+  Worker *w = workers[nextWorker++ % workers.size()];
+  // counted before being queued, so that a worker can never finish it first
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    pending++;
+    queued++;
+  }
+  {
+    std::lock_guard<std::mutex> guard(w->lock);
+    w->tasks.push_back(task);
+  }
+  workAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> guard(lock);
+  allDone.wait(guard, [this] { return pending == 0; });
+}
+
+int ThreadPool::size() { return workers.size(); }
+
+// popTask takes the most recent task of the worker at index or, if it has none,
+// steals the oldest task of another worker. It returns false if all the queues
+// are empty.
+bool ThreadPool::popTask(int index, Task& task) {
+  Worker *own = workers[index];
+  {
+    std::lock_guard<std::mutex> guard(own->lock);
+    if (!own->tasks.empty()) {
+      task = std::move(own->tasks.back());
+      own->tasks.pop_back();
+      return true;
+    }
+  }
+  for (size_t i = 1; i < workers.size(); i++) {
+    Worker *victim = workers[(index + i) % workers.size()];
+    std::lock_guard<std::mutex> guard(victim->lock);
+    if (!victim->tasks.empty()) {
+      task = std::move(victim->tasks.front());
+      victim->tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::run(int index) {
+  Task task;
+  while (true) {
+    if (popTask(index, task)) {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        queued--;
+      }
+      task();
+      task = nullptr;
+      std::lock_guard<std::mutex> guard(lock);
+      if (--pending == 0) {
+        allDone.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> guard(lock);
+    if (stopping) {
+      return;
+    }
+    workAvailable.wait(guard, [this] { return stopping || queued > 0; });
+  }
+}
+} // namespace utils
@@ -0,0 +1,62 @@
+#include "trace_ring.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace utils {
+const char TraceRing::MAGIC[8] = {'A', 'S', 'T', 'E', 'N', 'T', 'R', 'C'};
+
+TraceRing::TraceRing(std::string fileName, size_t c): capacity(c), next(0) {
+  if (capacity == 0)
+    throw std::runtime_error("trace capacity must be positive");
+  mappedSize = sizeof(Header) + capacity * sizeof(TraceRecord);
+  int fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    throw std::runtime_error("could not open trace file " + fileName);
+  if (ftruncate(fd, mappedSize) != 0) {
+    close(fd);
+    throw std::runtime_error("could not allocate trace file " + fileName);
+  }
+  mapped = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  // the mapping stays valid once the file is closed
+  close(fd);
+  if (mapped == MAP_FAILED)
+    throw std::runtime_error("could not map trace file " + fileName);
+
+  header = static_cast<Header*>(mapped);
+  std::memcpy(header->magic, MAGIC, sizeof(MAGIC));
+  header->version = VERSION;
+  header->recordSize = sizeof(TraceRecord);
+  header->capacity = capacity;
+  header->written = 0;
+  records = reinterpret_cast<TraceRecord*>(header + 1);
+}
+
+TraceRing::~TraceRing() {
+  munmap(mapped, mappedSize);
+}
+
+std::vector<TraceRecord> TraceRing::readAll(std::string fileName) {
+  std::ifstream in(fileName, std::ios::binary);
+  Header h;
+  if (!in.read((char*)&h, sizeof(h)) || std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0)
+    throw std::runtime_error(fileName + " is not a trace file");
+  if (h.version != VERSION || h.recordSize != sizeof(TraceRecord))
+    throw std::runtime_error(fileName + " was written by another version of asten");
+
+  std::vector<TraceRecord> ring(h.written < h.capacity ? h.written : h.capacity);
+  if (!in.read((char*)ring.data(), ring.size() * sizeof(TraceRecord)))
+    throw std::runtime_error(fileName + " is truncated");
+  // once the ring is full, the oldest record is the one that would be
+  // overwritten next
+  size_t oldest = h.written > h.capacity ? h.written % h.capacity : 0;
+  std::vector<TraceRecord> ordered(ring.begin() + oldest, ring.end());
+  ordered.insert(ordered.end(), ring.begin(), ring.begin() + oldest);
+  return ordered;
+}
+} // namespace utils
@@ -0,0 +1,123 @@
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "btnstream.h"
+#include "expect.h"
+
+using utils::BtnStream;
+using utils::FrameInput;
+using utils::Movie;
+
+namespace {
+const uint32_t ROM_HASH = 0x12345678;
+
+void writeMovie(std::string path, const std::vector<FrameInput>& frames) {
+  BtnStream out(path, utils::StreamMode::OUT);
+  out.setRomHash(ROM_HASH);
+  for (auto& input: frames)
+    out.writeFrame(input);
+  out.close();
+}
+
+Movie readMovie(std::string path) {
+  BtnStream in(path, utils::StreamMode::IN);
+  return in.readMovie();
+}
+
+void expectMovie(const Movie& movie, const std::vector<FrameInput>& frames) {
+  expect(movie.size() == (long)frames.size(), "the movie has " + std::to_string(movie.size()) + " frames");
+  for (size_t f = 0; f < frames.size(); f++)
+    expect(movie.at(f) == frames[f], "the input of frame " + std::to_string(f) + " differs");
+}
+
+// expectConversion writes a v1 button log of the test fixtures as a movie, and
+// reads it back
+void expectConversion(std::string path) {
+  Movie v1 = readMovie(path);
+  expect(v1.size() > 0, path + " is empty");
+  std::vector<FrameInput> frames;
+  for (long f = 0; f < v1.size(); f++)
+    frames.push_back(v1.at(f));
+  writeMovie("btnstream_converted.btn", frames);
+  expectMovie(readMovie("btnstream_converted.btn"), frames);
+}
+
+// expectV1Tail reads a v1 log where the reset records end before the button
+// ones: the buttons go on, and the reset button is released
+void expectV1Tail() {
+  {
+    std::ofstream out("btnstream_v1.btn", std::ios::binary);
+    long buttonsCount = 100, resetCount = 1;
+    uint8_t buttons = 0x81, reset = 1;
+    out.write("BTN", 3);
+    out.write((char*)&buttonsCount, sizeof(buttonsCount));
+    out.write((char*)&buttons, sizeof(buttons));
+    out.write("RST", 3);
+    out.write((char*)&resetCount, sizeof(resetCount));
+    out.write((char*)&reset, sizeof(reset));
+    out.write("END", 3);
+  }
+  Movie movie = readMovie("btnstream_v1.btn");
+  expect(movie.size() == 100, "the v1 log has " + std::to_string(movie.size()) + " frames");
+  expect(movie.at(0) == FrameInput({{0x81, 0}, true}), "the first frame of the v1 log differs");
+  expect(movie.at(99) == FrameInput({{0x81, 0}, false}), "the last frame of the v1 log differs");
+}
+
+// expectCorruptedLength reads a movie with a run longer than BtnStream allows
+void expectCorruptedLength() {
+  {
+    std::ofstream out("btnstream_corrupted.btn", std::ios::binary);
+    uint8_t version = 2;
+    uint32_t romHash = ROM_HASH;
+    // a varint of 2^62 frames
+    const uint8_t run[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x40, 0x01, 0x00, 0x00, 0x00};
+    out.write("MOV", 3);
+    out.write((char*)&version, sizeof(version));
+    out.write((char*)&romHash, sizeof(romHash));
+    out.write((char*)run, sizeof(run));
+  }
+  bool read = true;
+  try {
+    readMovie("btnstream_corrupted.btn");
+  } catch (const std::runtime_error&) {
+    read = false;
+  }
+  expect(!read, "a corrupted run length was accepted");
+}
+} // namespace
+
+// btnstream writes movies and reads them back: runs of identical frames of
+// any length, both controllers, and reset frames
+int main() {
+  std::mt19937 random(42);
+  std::vector<FrameInput> frames;
+  while (frames.size() < 5000) {
+    FrameInput input = {{(uint8_t)random(), (uint8_t)(random() % 4 == 0 ? random() : 0)}, random() % 20 == 0};
+    // runs of a single frame, and some longer than a varint byte can count
+    long length = random() % 3 == 0 ? 1 : 1 + random() % 300;
+    frames.insert(frames.end(), length, input);
+  }
+
+  writeMovie("btnstream.btn", frames);
+  Movie movie = readMovie("btnstream.btn");
+  expect(movie.romHash == ROM_HASH, "the ROM hash differs");
+  expectMovie(movie, frames);
+  // once the movie is over, its last buttons stay pressed, without reset
+  FrameInput last = frames.back();
+  last.reset = false;
+  expect(movie.at(frames.size()) == last, "the last buttons are not held");
+  expect(movie.at(frames.size() + 1000) == last, "the last buttons are not held");
+
+  writeMovie("btnstream_empty.btn", std::vector<FrameInput>());
+  expect(readMovie("btnstream_empty.btn").size() == 0, "the empty movie has frames");
+
+  expectV1Tail();
+  expectCorruptedLength();
+
+  expectConversion(TESTS_DIR "/nestest/nestest.btn");
+  expectConversion(TESTS_DIR "/ram_after_reset/ram_after_reset.btn");
+
+  return 0;
+}
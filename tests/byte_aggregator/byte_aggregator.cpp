@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "byte_aggregator.h"
+#include "expect.h"
+#include "screenstream.h"
+
+using utils::AggrBytes;
+using utils::ByteAggregator;
+
+namespace {
+// encodeByteByByte is the reference encoding, as v1 screen logs were written
+std::string encodeByteByByte(const std::vector<uint8_t>& bytes) {
+  ByteAggregator aggregator(ByteAggregator::CAP);
+  std::string out;
+  for (uint8_t byte: bytes) {
+    if (!aggregator.canLoad(byte)) {
+      utils::appendAggrBytes(out, aggregator.aggregate());
+      aggregator.reset();
+    }
+    aggregator.load(byte);
+  }
+  utils::appendAggrBytes(out, aggregator.aggregate());
+  return out;
+}
+
+// encode loads bytes in pieces of random sizes
+std::string encode(const std::vector<uint8_t>& bytes, std::mt19937& random) {
+  ByteAggregator aggregator(ByteAggregator::CAP);
+  std::string out;
+  size_t i = 0;
+  while (i < bytes.size()) {
+    size_t size = std::min((size_t)(1 + random() % 100000), bytes.size() - i);
+    aggregator.loadAll(&bytes[i], size, out);
+    i += size;
+  }
+  utils::appendAggrBytes(out, aggregator.aggregate());
+  return out;
+}
+
+// decode decodes runs into pieces of random sizes
+std::vector<uint8_t> decode(const std::string& encoded, std::mt19937& random) {
+  const uint8_t *data = (const uint8_t*)encoded.data();
+  const uint8_t *end = data + encoded.size();
+  AggrBytes run;
+  std::vector<uint8_t> bytes;
+  std::vector<uint8_t> piece;
+  while (true) {
+    piece.resize(1 + random() % 70000);
+    size_t filled = utils::decodeAggrBytes(data, end, run, piece.data(), piece.size());
+    if (filled == 0)
+      return bytes;
+    bytes.insert(bytes.end(), piece.begin(), piece.begin() + filled);
+  }
+}
+
+// expectFixture decodes a v1 screen log of the integration tests, and checks
+// that encoding it again gives the same file
+void expectFixture(std::string path, std::mt19937& random) {
+  std::ifstream in(path, std::ios::binary);
+  std::string file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  expect(!file.empty() && (uint8_t)file.back() == utils::SCREENSTREAM_END, path + " is not a v1 screen log");
+  std::string runs = file.substr(0, file.size() - 1);
+  std::vector<uint8_t> pixels = decode(runs, random);
+  expect(encode(pixels, random) == runs, path + " is encoded differently");
+}
+} // namespace
+
+// byte_aggregator checks that encoding and decoding runs in bulk gives the
+// same bytes as one byte at a time, with runs longer than a byte and than two
+// bytes can count
+int main() {
+  std::mt19937 random(42);
+  const size_t lengths[] = {1, 2, 17, 254, 255, 256, 257, 4000, 65534, 65535, 65536, 65537, 200000};
+  std::vector<uint8_t> bytes;
+  for (int i = 0; i < 300; i++) {
+    size_t length = random() % 2 == 0 ? lengths[random() % 13] : 1 + random() % 40;
+    bytes.insert(bytes.end(), length, random() % ByteAggregator::MAX);
+  }
+
+  std::string encoded = encodeByteByByte(bytes);
+  expect(encode(bytes, random) == encoded, "bulk encoding differs from loading byte by byte");
+  expect(decode(encoded, random) == bytes, "decoding does not give the bytes back");
+
+  for (int i = 0; i < 1000; i++) {
+    size_t start = random() % bytes.size();
+    size_t end = start;
+    while (end < bytes.size() && bytes[end] == bytes[start])
+      end++;
+    expect(utils::findRunEnd(bytes.data(), start, bytes.size()) == end, "wrong end for the run at " + std::to_string(start));
+  }
+
+  expectFixture(TESTS_DIR "/nestest/nestest.scrn", random);
+  expectFixture(TESTS_DIR "/ram_after_reset/ram_after_reset.scrn", random);
+
+  return 0;
+}
@@ -0,0 +1,14 @@
+#ifndef GUARD_EXPECT_H
+#define GUARD_EXPECT_H
+
+#include <stdexcept>
+#include <string>
+
+// expect throws if condition does not hold, which fails the test: like the
+// integration tests, unit tests fail by not returning
+inline void expect(bool condition, const std::string& message) {
+  if (!condition)
+    throw std::runtime_error(message);
+}
+
+#endif
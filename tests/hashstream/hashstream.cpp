@@ -0,0 +1,72 @@
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "expect.h"
+#include "hash.h"
+#include "hashstream.h"
+#include "screenstream.h"
+
+using utils::HashStream;
+
+namespace {
+const int SCREEN_SIZE = 2048;
+const int FRAMES = 200;
+const int KEYFRAME_INTERVAL = 60;
+const uint32_t ROM_HASH = 0x12345678;
+} // namespace
+
+// hashstream writes a golden file and reads it back: each frame has its hash,
+// and every KEYFRAME_INTERVAL frames its pixels
+int main() {
+  std::mt19937 random(42);
+  std::vector<std::vector<uint8_t>> frames;
+  std::vector<uint8_t> frame(SCREEN_SIZE);
+  for (int f = 0; f < FRAMES; f++) {
+    // some frames repeat the previous one
+    if (f % 3 != 0)
+      frame[random() % SCREEN_SIZE] = random() % 64;
+    frames.push_back(frame);
+  }
+
+  {
+    HashStream out("hashstream.golden", utils::StreamMode::OUT, SCREEN_SIZE, KEYFRAME_INTERVAL);
+    out.setRomHash(ROM_HASH);
+    for (auto& f: frames)
+      out.writeFrame(f.data());
+    out.close();
+  }
+
+  expect(HashStream::isGoldenFile("hashstream.golden"), "the golden file is not recognized");
+  HashStream in("hashstream.golden", utils::StreamMode::IN, SCREEN_SIZE);
+  expect(in.getRomHash() == ROM_HASH, "the ROM hash differs");
+  expect(in.getKeyframeInterval() == KEYFRAME_INTERVAL, "the keyframe interval differs");
+  uint64_t hash;
+  const uint8_t *keyframe;
+  for (int f = 0; f < FRAMES; f++) {
+    std::string name = "frame " + std::to_string(f);
+    expect(in.readFrame(hash, keyframe), name + " is missing");
+    expect(hash == utils::hash64(frames[f].data(), SCREEN_SIZE), name + " has another hash");
+    if (f % KEYFRAME_INTERVAL == 0) {
+      expect(keyframe != NULL, name + " should be kept whole");
+      expect(std::memcmp(keyframe, frames[f].data(), SCREEN_SIZE) == 0, name + " was not kept as is");
+    } else {
+      expect(keyframe == NULL, name + " should only be hashed");
+    }
+  }
+  expect(!in.readFrame(hash, keyframe), "nothing should follow the last frame");
+
+  // frames that differ by a single pixel have different hashes
+  frame = frames.back();
+  frame[SCREEN_SIZE / 2] ^= 1;
+  expect(utils::hash64(frame.data(), SCREEN_SIZE) != hash, "a pixel that changed went unnoticed");
+
+  // screen logs are not golden files
+  utils::ScreenStream screenLog("hashstream.scrn", utils::StreamMode::OUT, SCREEN_SIZE);
+  screenLog.writeFrame(frames[0].data());
+  screenLog.close();
+  expect(!HashStream::isGoldenFile("hashstream.scrn"), "a screen log was taken for a golden file");
+
+  return 0;
+}
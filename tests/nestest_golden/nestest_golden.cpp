@@ -0,0 +1,55 @@
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "console.h"
+#include "io_interface.h"
+#include "ppu.h"
+
+// nestest_golden records a golden file of nestest (once it matches its screen
+// log), runs nestest against it, then checks that a frame that differs from
+// the golden file is reported
+namespace {
+void run(Console& console) {
+  while (console.isRunning()) {
+    console.step();
+  }
+}
+} // namespace
+
+int main() {
+  long frames;
+  {
+    Console console("nestest.nes", InterfaceType::DEBUG_INTERFACE, "nestest.btn", "nestest.scrn");
+    run(console);
+    frames = console.getPpu().getFrameCount();
+  }
+  {
+    Console console("nestest.nes", InterfaceType::PLAYBACK, "nestest.btn", "nestest.golden");
+    while (console.getPpu().getFrameCount() < frames) {
+      console.step();
+    }
+  }
+  {
+    Console console("nestest.nes", InterfaceType::DEBUG_INTERFACE, "nestest.btn", "nestest.golden");
+    run(console);
+  }
+
+  // the hash of the first frame follows the 16 byte header
+  {
+    std::fstream golden("nestest.golden", std::ios::binary | std::ios::in | std::ios::out);
+    golden.seekg(16);
+    char byte = golden.get();
+    golden.seekp(16);
+    golden.put(~byte);
+  }
+  try {
+    Console console("nestest.nes", InterfaceType::DEBUG_INTERFACE, "nestest.btn", "nestest.golden");
+    run(console);
+  } catch (const std::runtime_error& e) {
+    if (std::string(e.what()).find("frame 0 ") == std::string::npos)
+      throw;
+    return 0;
+  }
+  throw std::runtime_error("a frame differing from the golden file was not reported");
+}
@@ -0,0 +1,33 @@
+#include "console.h"
+#include "io_interface.h"
+#include "mapper.h"
+#include "screenstream.h"
+
+// nestest_v2 runs nestest against its screen log converted to the v2 format,
+// as asten-scrn convert does
+int main() {
+  const int screenSize = IOInterface::WIDTH * IOInterface::HEIGHT;
+  {
+    utils::ScreenStream in("nestest.scrn", utils::StreamMode::IN, screenSize);
+    utils::ScreenStream out("nestest_v2.scrn", utils::StreamMode::OUT, screenSize);
+    Console rom("nestest.nes", InterfaceType::SINK, "", "");
+    out.setRomHash(rom.getMapper()->romHash());
+    uint8_t palette;
+    while ((palette = in.read()) != utils::SCREENSTREAM_END)
+      out.write(palette);
+    out.close();
+  }
+
+  Console console(
+    "nestest.nes",
+    InterfaceType::DEBUG_INTERFACE,
+    "nestest.btn",
+    "nestest_v2.scrn"
+  );
+
+  while (console.isRunning()) {
+    console.step();
+  }
+
+  return 0;
+}
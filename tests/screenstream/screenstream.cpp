@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "expect.h"
+#include "screenstream.h"
+
+using utils::ScreenStream;
+
+namespace {
+// small screens keep the test fast, but span several rows of ROW_SIZE pixels
+const int ROWS = 8;
+const int SCREEN_SIZE = ROWS * ScreenStream::ROW_SIZE;
+const int FRAMES = 650;
+const int PARTIAL_SIZE = 100;
+const uint32_t ROM_HASH = 0x12345678;
+
+// makeFrames returns frames that exercise every kind of record: frames that
+// repeat the previous one, frames where a few rows change (some to a single
+// color, some to noise), and frames that change entirely
+std::vector<std::vector<uint8_t>> makeFrames() {
+  std::mt19937 random(42);
+  std::vector<std::vector<uint8_t>> frames;
+  std::vector<uint8_t> frame(SCREEN_SIZE, 0x0f);
+  for (int f = 0; f < FRAMES; f++) {
+    if (f % 50 == 0) {
+      for (auto& pixel: frame)
+        pixel = random() % 64;
+    } else if (f % 7 != 0) {
+      int row = random() % ROWS;
+      uint8_t *start = &frame[row * ScreenStream::ROW_SIZE];
+      if (f % 2 == 0) {
+        std::memset(start, random() % 64, ScreenStream::ROW_SIZE);
+      } else {
+        for (int i = random() % 16; i < ScreenStream::ROW_SIZE; i += 1 + random() % 32)
+          start[i] = random() % 64;
+      }
+    }
+    frames.push_back(frame);
+  }
+  return frames;
+}
+
+// writeLog writes frames, then PARTIAL_SIZE pixels of a last frame. Some
+// frames are written pixel by pixel, as SpyInterface does.
+void writeLog(std::string path, utils::ScreenFormat format, const std::vector<std::vector<uint8_t>>& frames) {
+  ScreenStream out(path, utils::StreamMode::OUT, SCREEN_SIZE, format);
+  out.setRomHash(ROM_HASH);
+  for (size_t f = 0; f < frames.size(); f++) {
+    if (f % 5 == 1) {
+      for (uint8_t pixel: frames[f])
+        out.write(pixel);
+    } else {
+      out.writeFrame(frames[f].data());
+    }
+  }
+  for (int i = 0; i < PARTIAL_SIZE; i++)
+    out.write(frames[0][i]);
+  out.close();
+}
+
+// expectFrames reads the frames back one after the other
+void expectFrames(ScreenStream& in, const std::vector<std::vector<uint8_t>>& frames) {
+  std::vector<uint8_t> pixels(SCREEN_SIZE);
+  for (size_t f = 0; f < frames.size(); f++) {
+    expect(in.readPixels(pixels.data()) == SCREEN_SIZE, "frame " + std::to_string(f) + " is missing");
+    expect(pixels == frames[f], "frame " + std::to_string(f) + " differs");
+  }
+  expect(in.readPixels(pixels.data()) == PARTIAL_SIZE, "the last frame should be partial");
+  expect(std::memcmp(pixels.data(), frames[0].data(), PARTIAL_SIZE) == 0, "the last frame differs");
+  expect(in.readPixels(pixels.data()) == 0, "nothing should follow the last frame");
+}
+
+// expectSeeks seeks to frames on either side of chunk boundaries, in both
+// directions, and checks that what follows is what a sequential read gives
+void expectSeeks(ScreenStream& in, const std::vector<std::vector<uint8_t>>& frames) {
+  const long targets[] = {0, 1, 299, 300, 301, 649, 5, 600, 599, 650, 0};
+  std::vector<uint8_t> pixels(SCREEN_SIZE);
+  for (long target: targets) {
+    in.seek(target);
+    for (long f = target; f < target + 3 && f < (long)frames.size(); f++) {
+      in.readPixels(pixels.data());
+      expect(pixels == frames[f], "frame " + std::to_string(f) + " differs after seeking " + std::to_string(target));
+    }
+    if (target == FRAMES)
+      expect(in.readPixels(pixels.data()) == PARTIAL_SIZE, "the partial frame should follow the last one");
+  }
+}
+
+// expectChunks decodes each chunk on its own
+void expectChunks(ScreenStream& in, const std::vector<std::vector<uint8_t>>& frames) {
+  expect(in.getChunkCount() == (FRAMES + ScreenStream::CHUNK_FRAMES - 1) / ScreenStream::CHUNK_FRAMES, "the chunk count differs");
+  std::vector<uint8_t> pixels;
+  for (int chunk = 0; chunk < in.getChunkCount(); chunk++)
+    ScreenStream::decodeChunk(in.readChunk(chunk), SCREEN_SIZE, pixels);
+  expect(pixels.size() == (size_t)FRAMES * SCREEN_SIZE + PARTIAL_SIZE, "the chunks do not hold every pixel");
+  for (size_t f = 0; f < frames.size(); f++)
+    expect(std::equal(frames[f].begin(), frames[f].end(), &pixels[f * SCREEN_SIZE]), "frame " + std::to_string(f) + " differs in its chunk");
+}
+} // namespace
+
+int main() {
+  auto frames = makeFrames();
+
+  writeLog("screenstream.scrn", utils::SCREEN_V2, frames);
+  ScreenStream v2("screenstream.scrn", utils::StreamMode::IN, SCREEN_SIZE);
+  expect(v2.getFormat() == utils::SCREEN_V2, "the log should be read as v2");
+  expect(v2.getRomHash() == ROM_HASH, "the ROM hash differs");
+  expect(v2.getFrameCount() == FRAMES, "the frame count differs");
+  expectFrames(v2, frames);
+  expectSeeks(v2, frames);
+  expectChunks(v2, frames);
+
+  writeLog("screenstream_v1.scrn", utils::SCREEN_V1, frames);
+  ScreenStream v1("screenstream_v1.scrn", utils::StreamMode::IN, SCREEN_SIZE);
+  expect(v1.getFormat() == utils::SCREEN_V1, "the log should be read as v1");
+  expectFrames(v1, frames);
+  bool seeked = true;
+  try {
+    v1.seek(0);
+  } catch (const std::runtime_error&) {
+    seeked = false;
+  }
+  expect(!seeked, "v1 logs cannot be seeked");
+
+  return 0;
+}
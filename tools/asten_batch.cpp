@@ -0,0 +1,134 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "console.h"
+#include "logger.h"
+#include "io_interface.h"
+#include "thread_pool.h"
+
+// Job is one line of the manifest
+struct Job {
+  std::string romPath;
+  std::string btnLogPath;
+  long frames;
+  std::string scrnLogPath;
+
+  // filled once the job has run
+  bool ok;
+  std::string error;
+  double seconds;
+};
+
+// readManifest parses a manifest, made of one job per line:
+//   ROM_FILE BUTTON_LOG FRAMES OUTPUT
+// where BUTTON_LOG and OUTPUT can be "-" (no input, respectively no output).
+// Empty lines and lines starting with # are ignored.
+std::vector<Job> readManifest(std::string path) {
+  std::ifstream manifest(path);
+  if (!manifest.is_open()) {
+    throw std::runtime_error("cannot open manifest " + path);
+  }
+  std::vector<Job> jobs;
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(manifest, line)) {
+    lineNumber++;
+    std::istringstream fields(line);
+    Job job;
+    if (!(fields >> job.romPath) || job.romPath[0] == '#') {
+      continue;
+    }
+    if (!(fields >> job.btnLogPath >> job.frames >> job.scrnLogPath)) {
+      throw std::runtime_error(
+        path + ":" + std::to_string(lineNumber) + ": expected ROM_FILE BUTTON_LOG FRAMES OUTPUT"
+      );
+    }
+    if (job.btnLogPath == "-") job.btnLogPath = "";
+    if (job.scrnLogPath == "-") job.scrnLogPath = "";
+    job.ok = false;
+    job.seconds = 0;
+    jobs.push_back(job);
+  }
+  return jobs;
+}
+
+// runJob emulates job.frames frames of the job's ROM on a console of its own
+void runJob(Job& job) {
+  auto start = std::chrono::steady_clock::now();
+  try {
+    InterfaceType type = InterfaceType::SINK;
+    if (job.btnLogPath != "" || job.scrnLogPath != "") {
+      type = InterfaceType::PLAYBACK;
+    }
+    Console console(job.romPath, type, job.btnLogPath, job.scrnLogPath);
+    while (console.getPpu().getFrameCount() < job.frames) {
+      console.step();
+    }
+    job.ok = true;
+  } catch (const std::exception& e) {
+    job.error = e.what();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  job.seconds = elapsed.count();
+}
+
+int main(int argc, char* argv[]) {
+  Logger log = Logger::getLogger("batch");
+  std::string manifestPath;
+  int threads = 0;
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "-j" && i + 1 < argc)
+      threads = std::stoi(argv[++i]);
+    else
+      manifestPath = arg;
+  }
+  if (manifestPath == "") {
+    log.error() << "Oops, path to a manifest was not provided\n";
+    log.error() << "usage: asten-batch [-j THREADS] <MANIFEST>\n";
+    return -1;
+  }
+
+  std::vector<Job> jobs;
+  try {
+    jobs = readManifest(manifestPath);
+  } catch (const std::exception& e) {
+    log.error() << e.what() << "\n";
+    return -1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    utils::ThreadPool pool(threads);
+    log.info() << "running " << jobs.size() << " jobs on " << pool.size() << " threads\n";
+    for (auto& job: jobs) {
+      Job *j = &job;
+      pool.submit([j] { runJob(*j); });
+    }
+    pool.wait();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  long totalFrames = 0;
+  int failures = 0;
+  for (auto& job: jobs) {
+    if (!job.ok) {
+      failures++;
+      log.error() << job.romPath << ": " << job.error << "\n";
+      continue;
+    }
+    totalFrames += job.frames;
+    log.info() << job.romPath << ": " << job.frames << " frames in "
+               << std::fixed << std::setprecision(3) << job.seconds << "s ("
+               << std::setprecision(1) << job.frames / job.seconds << " fps)\n";
+  }
+  log.info() << jobs.size() - failures << "/" << jobs.size() << " jobs done in "
+             << std::fixed << std::setprecision(3) << elapsed.count() << "s, "
+             << std::setprecision(1) << totalFrames / elapsed.count() << " frames/s\n";
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "console.h"
+#include "cpu.h"
+#include "logger.h"
+#include "instrumentation.h"
+#include "io_interface.h"
+#include "profiler.h"
+
+// Run holds the measures of one run
+struct Run {
+  double seconds;
+  long frames;
+  long instructions;
+  long dots;
+};
+
+// Stat summarizes one measure over all the runs
+struct Stat {
+  double median, stddev;
+};
+
+Stat summarize(std::vector<double> values) {
+  Stat s;
+  std::sort(values.begin(), values.end());
+  size_t n = values.size();
+  s.median = n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+  double mean = 0;
+  for (double v: values) mean += v;
+  mean /= n;
+  double variance = 0;
+  for (double v: values) variance += (v - mean) * (v - mean);
+  s.stddev = n > 1 ? std::sqrt(variance / (n - 1)) : 0;
+  return s;
+}
+
+// peakRss returns the peak resident set size of the process, in kilobytes
+long peakRss() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  // bytes on macOS, kilobytes on linux
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+// runOnce emulates frames frames of the ROM as fast as possible. Loading the
+// ROM is not measured. If guestProfile is set, the emulated code is profiled,
+// and the profile written to guestProfile.txt and guestProfile.folded. If
+// tracePath is set, the instructions are traced to it.
+Run runOnce(std::string romPath, std::string btnLogPath, long frames, std::string guestProfile, std::string tracePath) {
+  InterfaceType type = btnLogPath != "" ? InterfaceType::PLAYBACK : InterfaceType::SINK;
+  Console console(romPath, type, btnLogPath, "");
+  GuestProfiler *profiler = guestProfile != "" ? console.enableGuestProfiler() : NULL;
+  if (tracePath != "")
+    console.enableTrace(tracePath);
+  long cycles = 0;
+  auto start = std::chrono::steady_clock::now();
+  while (console.getPpu().getFrameCount() < frames) {
+    cycles += console.step();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  if (profiler != NULL) {
+    std::ofstream report(guestProfile + ".txt");
+    profiler->writeReport(report);
+    std::ofstream folded(guestProfile + ".folded");
+    profiler->writeFolded(folded);
+  }
+
+  Run run;
+  run.seconds = elapsed.count();
+  run.frames = console.getPpu().getFrameCount();
+  run.instructions = console.getCpu().getInstructionCount();
+  // the PPU runs 3 dots per CPU cycle
+  run.dots = 3 * cycles;
+  return run;
+}
+
+void printText(std::ostream& out, std::string romPath, const std::vector<Run>& runs, Stat fps, Stat ips, Stat dps, long rss) {
+  out << std::fixed;
+  out << "rom:          " << romPath << "\n";
+  out << "runs:         " << runs.size() << " x " << runs[0].frames << " frames\n";
+  out << std::setprecision(1);
+  out << "frames/s:     " << fps.median << " (stddev " << fps.stddev << ")\n";
+  out << std::setprecision(0);
+  out << "instr/s:      " << ips.median << " (stddev " << ips.stddev << ")\n";
+  out << "PPU dots/s:   " << dps.median << " (stddev " << dps.stddev << ")\n";
+  out << "peak RSS:     " << rss << " KB\n";
+}
+
+void printJson(std::ostream& out, std::string romPath, const std::vector<Run>& runs, Stat fps, Stat ips, Stat dps, long rss) {
+  out << std::fixed << std::setprecision(3);
+  out << "{\n";
+  out << "  \"rom\": \"" << romPath << "\",\n";
+  out << "  \"frames\": " << runs[0].frames << ",\n";
+  out << "  \"fps\": {\"median\": " << fps.median << ", \"stddev\": " << fps.stddev << "},\n";
+  out << "  \"instructions_per_second\": {\"median\": " << ips.median << ", \"stddev\": " << ips.stddev << "},\n";
+  out << "  \"dots_per_second\": {\"median\": " << dps.median << ", \"stddev\": " << dps.stddev << "},\n";
+  out << "  \"peak_rss_kb\": " << rss << ",\n";
+  out << "  \"runs\": [";
+  for (size_t i = 0; i < runs.size(); i++) {
+    out << (i ? ", " : "") << "{\"seconds\": " << runs[i].seconds
+        << ", \"instructions\": " << runs[i].instructions
+        << ", \"dots\": " << runs[i].dots << "}";
+  }
+  out << "]\n";
+  out << "}\n";
+}
+
+int main(int argc, char* argv[]) {
+  Logger log = Logger::getLogger("bench");
+  std::string romPath, btnLogPath, guestProfile, tracePath;
+  long frames = 600;
+  int repeat = 1;
+  bool json = false;
+  std::vector<uint16_t> watchpoints;
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--frames" && i + 1 < argc)
+      frames = std::stol(argv[++i]);
+    else if (arg == "--repeat" && i + 1 < argc)
+      repeat = std::stoi(argv[++i]);
+    else if (arg == "--input" && i + 1 < argc)
+      btnLogPath = argv[++i];
+    else if (arg == "--guest-profile" && i + 1 < argc)
+      guestProfile = argv[++i];
+    else if (arg == "--trace" && i + 1 < argc)
+      tracePath = argv[++i];
+    else if (arg == "--watch" && i + 1 < argc)
+      watchpoints.push_back(std::stoi(argv[++i], nullptr, 16));
+    else if (arg == "--json")
+      json = true;
+    else
+      romPath = arg;
+  }
+  if (romPath == "" || frames <= 0 || repeat <= 0) {
+    log.error() << "Oops, path to a .nes file was not provided\n";
+    log.error() << "usage: asten-bench [--frames N] [--repeat RUNS] [--input BUTTON_LOG] [--guest-profile PREFIX] [--trace TRACE_FILE] [--watch ADDRESS] [--json] <ROM_FILE>\n";
+    return -1;
+  }
+
+#ifndef ASTEN_DEBUG_INSTRUMENTATION
+  if (!watchpoints.empty()) {
+    log.error() << "--watch needs asten to be built with ASTEN_DEBUG_INSTRUMENTATION\n";
+    return -1;
+  }
+#endif
+  for (uint16_t address: watchpoints)
+    utils::Instrumentation::get().watch(utils::CPU_BUS, address);
+
+  std::vector<Run> runs;
+  try {
+    for (int i = 0; i < repeat; i++) {
+      // only the first run is profiled and traced, so that the others
+      // measure the emulator alone
+      runs.push_back(runOnce(romPath, btnLogPath, frames, i == 0 ? guestProfile : "", i == 0 ? tracePath : ""));
+    }
+  } catch (const std::exception& e) {
+    log.error() << e.what() << "\n";
+    return -1;
+  }
+
+  std::vector<double> fps, ips, dps;
+  for (auto& r: runs) {
+    fps.push_back(r.frames / r.seconds);
+    ips.push_back(r.instructions / r.seconds);
+    dps.push_back(r.dots / r.seconds);
+  }
+
+  // the report is the output of the program rather than a log, so that it
+  // can be parsed
+  if (json)
+    printJson(std::cout, romPath, runs, summarize(fps), summarize(ips), summarize(dps), peakRss());
+  else
+    printText(std::cout, romPath, runs, summarize(fps), summarize(ips), summarize(dps), peakRss());
+#ifdef ASTEN_PROFILER
+  utils::Profiler::get().printTable(json ? std::cerr : std::cout);
+  utils::Profiler::get().writeTrace(utils::PROFILE_TRACE_FILE);
+#endif
+#ifdef ASTEN_DEBUG_INSTRUMENTATION
+  utils::Instrumentation::get().printCounters(json ? std::cerr : std::cout);
+#endif
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "console.h"
+#include "logger.h"
+#include "io_interface.h"
+#include "mapper.h"
+#include "screenstream.h"
+#include "hashstream.h"
+#include "thread_pool.h"
+
+// asten-scrn inspects screen logs and golden files, and converts screen logs
+// to the current format.
+
+namespace {
+const int SCREEN_SIZE = IOInterface::WIDTH * IOInterface::HEIGHT;
+
+// info prints what a screen log or a golden file holds. The chunks of a v2
+// log are decoded on all cores, which also checks that it is not corrupted.
+void info(std::string path) {
+  if (utils::HashStream::isGoldenFile(path)) {
+    utils::HashStream in(path, utils::StreamMode::IN, SCREEN_SIZE);
+    uint64_t hash;
+    const uint8_t *keyframe;
+    long frames = 0, keyframes = 0;
+    while (in.readFrame(hash, keyframe)) {
+      frames++;
+      keyframes += keyframe != NULL;
+    }
+    printf("format:       golden\n");
+    printf("ROM hash:     %08X\n", in.getRomHash());
+    printf("frames:       %ld (%ld kept whole)\n", frames, keyframes);
+    return;
+  }
+  utils::ScreenStream in(path, utils::StreamMode::IN, SCREEN_SIZE);
+  auto start = std::chrono::steady_clock::now();
+  long pixels = 0;
+  if (in.getFormat() == utils::SCREEN_V1) {
+    printf("format:       v1\n");
+    while (in.read() != utils::SCREENSTREAM_END)
+      pixels++;
+  } else {
+    printf("format:       v2\n");
+    printf("ROM hash:     %08X\n", in.getRomHash());
+    printf("chunks:       %d of %d frames\n", in.getChunkCount(), in.getChunkFrames());
+    std::vector<std::vector<uint8_t>> chunks;
+    for (int i = 0; i < in.getChunkCount(); i++)
+      chunks.push_back(in.readChunk(i));
+    std::atomic<long> decoded(0);
+    std::atomic<int> errors(0);
+    {
+      utils::ThreadPool pool;
+      for (auto& chunk: chunks) {
+        pool.submit([&decoded, &errors, &chunk]() {
+          try {
+            std::vector<uint8_t> frames;
+            decoded += utils::ScreenStream::decodeChunk(chunk, SCREEN_SIZE, frames);
+          } catch (const std::exception&) {
+            errors++;
+          }
+        });
+      }
+    }
+    if (errors > 0)
+      throw std::runtime_error(std::to_string(errors) + " corrupted chunks");
+    pixels = decoded;
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  printf("frames:       %ld", pixels / SCREEN_SIZE);
+  if (pixels % SCREEN_SIZE != 0)
+    printf(" (and %ld pixels)", pixels % SCREEN_SIZE);
+  printf("\ndecoded in:   %.1f ms\n", elapsed.count() * 1000);
+}
+
+// convert rewrites a screen log in the current format
+void convert(std::string inPath, std::string outPath, std::string romPath) {
+  utils::ScreenStream in(inPath, utils::StreamMode::IN, SCREEN_SIZE);
+  utils::ScreenStream out(outPath, utils::StreamMode::OUT, SCREEN_SIZE);
+  if (romPath != "") {
+    Console console(romPath, InterfaceType::SINK, "", "");
+    out.setRomHash(console.getMapper()->romHash());
+  } else {
+    out.setRomHash(in.getRomHash());
+  }
+  uint8_t palette;
+  while ((palette = in.read()) != utils::SCREENSTREAM_END)
+    out.write(palette);
+  out.close();
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+  Logger log = Logger::getLogger("scrn");
+  std::vector<std::string> args;
+  std::string romPath;
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--rom" && i + 1 < argc)
+      romPath = argv[++i];
+    else
+      args.push_back(arg);
+  }
+  bool isInfo = args.size() == 2 && args[0] == "info";
+  bool isConvert = args.size() == 3 && args[0] == "convert";
+  if (!isInfo && !isConvert) {
+    log.error() << "usage: asten-scrn info <SCREEN_LOG>\n";
+    log.error() << "       asten-scrn convert [--rom ROM_FILE] <INPUT> <OUTPUT>\n";
+    return -1;
+  }
+
+  try {
+    if (isInfo)
+      info(args[1]);
+    else
+      convert(args[1], args[2], romPath);
+  } catch (const std::exception& e) {
+    log.error() << e.what() << "\n";
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,57 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "cpu.h"
+#include "logger.h"
+#include "trace_ring.h"
+
+// asten-trace prints a trace recorded by asten (see Console::enableTrace) in
+// the format of nestest.log, so that both can be compared with diff.
+// nestest.log also shows the values read from memory ("LDA $0200 = 00"),
+// which are not recorded, and are not printed.
+int main(int argc, char* argv[]) {
+  Logger log = Logger::getLogger("trace");
+  std::string tracePath;
+  long last = 0;
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--last" && i + 1 < argc)
+      last = std::stol(argv[++i]);
+    else
+      tracePath = arg;
+  }
+  if (tracePath == "" || last < 0) {
+    log.error() << "Oops, path to a trace file was not provided\n";
+    log.error() << "usage: asten-trace [--last N] <TRACE_FILE>\n";
+    return -1;
+  }
+
+  std::vector<utils::TraceRecord> records;
+  try {
+    records = utils::TraceRing::readAll(tracePath);
+  } catch (const std::exception& e) {
+    log.error() << e.what() << "\n";
+    return -1;
+  }
+
+  size_t first = last > 0 && (size_t)last < records.size() ? records.size() - last : 0;
+  for (size_t i = first; i < records.size(); i++) {
+    const utils::TraceRecord& r = records[i];
+    std::string text = CPU::disassemble(r.pc, r.opcode, r.operands[0], r.operands[1]);
+    // unofficial instructions are marked with a * right before the mnemonic
+    if (text[0] != '*')
+      text = " " + text;
+
+    char bytes[9];
+    switch (CPU::instructionSize(r.opcode)) {
+      case 3: snprintf(bytes, sizeof(bytes), "%02X %02X %02X", r.opcode, r.operands[0], r.operands[1]); break;
+      case 2: snprintf(bytes, sizeof(bytes), "%02X %02X", r.opcode, r.operands[0]); break;
+      default: snprintf(bytes, sizeof(bytes), "%02X", r.opcode); break;
+    }
+    printf("%04X  %-8s %-33sA:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d CYC:%llu\n",
+      r.pc, bytes, text.c_str(), r.A, r.X, r.Y, r.P, r.sp, r.scanLine, r.dot,
+      (unsigned long long)r.cycle);
+  }
+  return 0;
+}